@@ -10,7 +10,7 @@ struct pic_fullcont {
   char *stk_pos, *stk_ptr;
   ptrdiff_t stk_len;
 
-  pic_value *st_ptr;
+  pic_value *st_ptr, *stbase;
   size_t sp_offset;
   ptrdiff_t st_len;
 
@@ -51,7 +51,6 @@ cont_mark(pic_state *pic, void *data, void (*mark)(pic_state *, pic_value))
   struct pic_fullcont *cont = data;
   pic_checkpoint *cp;
   pic_value *stack;
-  pic_callinfo *ci;
   struct pic_proc **xp;
   size_t i;
 
@@ -70,13 +69,6 @@ cont_mark(pic_state *pic, void *data, void (*mark)(pic_state *, pic_value))
     mark(pic, *stack);
   }
 
-  /* callinfo */
-  for (ci = cont->ci_ptr + cont->ci_offset; ci != cont->ci_ptr; --ci) {
-    if (ci->cxt) {
-      mark(pic, pic_obj_value(ci->cxt));
-    }
-  }
-
   /* exception handlers */
   for (xp = cont->xp_ptr; xp != cont->xp_ptr + cont->xp_offset; ++xp) {
     mark(pic, pic_obj_value(*xp));
@@ -92,6 +84,9 @@ cont_mark(pic_state *pic, void *data, void (*mark)(pic_state *, pic_value))
 
   /* result values */
   mark(pic, cont->results);
+
+  /* the saved native stack may hold any object */
+  pic_gc_pin(pic, cont->stk_ptr, cont->stk_len);
 }
 
 static const pic_data_type cont_type = { "continuation", cont_dtor, cont_mark };
@@ -116,12 +111,9 @@ native_stack_length(pic_state *pic, char **pos)
 static void
 save_cont(pic_state *pic, struct pic_fullcont **c)
 {
-  void pic_vm_tear_off(pic_state *);
   struct pic_fullcont *cont;
   char *pos;
 
-  pic_vm_tear_off(pic);         /* tear off */
-
   cont = *c = pic_malloc(pic, sizeof(struct pic_fullcont));
 
   cont->prev_jmp = pic->cc;
@@ -134,13 +126,14 @@ save_cont(pic_state *pic, struct pic_fullcont **c)
   cont->stk_ptr = pic_malloc(pic, cont->stk_len);
   memcpy(cont->stk_ptr, cont->stk_pos, cont->stk_len);
 
+  cont->stbase = pic->stbase;
   cont->sp_offset = pic->sp - pic->stbase;
-  cont->st_len = pic->stend - pic->stbase;
+  cont->st_len = pic->sp - pic->stbase;
   cont->st_ptr = pic_malloc(pic, sizeof(pic_value) * cont->st_len);
   memcpy(cont->st_ptr, pic->stbase, sizeof(pic_value) * cont->st_len);
 
   cont->ci_offset = pic->ci - pic->cibase;
-  cont->ci_len = pic->ciend - pic->cibase;
+  cont->ci_len = pic->ci - pic->cibase + 1;
   cont->ci_ptr = pic_malloc(pic, sizeof(pic_callinfo) * cont->ci_len);
   memcpy(cont->ci_ptr, pic->cibase, sizeof(pic_callinfo) * cont->ci_len);
 
@@ -175,6 +168,7 @@ restore_cont(pic_state *pic, struct pic_fullcont *cont)
 {
   char v;
   struct pic_fullcont *tmp = cont;
+  pic_callinfo *ci;
 
   if (&v < pic->native_stack_start) {
     if (&v > cont->stk_pos) native_stack_extend(pic, cont);
@@ -186,15 +180,33 @@ restore_cont(pic_state *pic, struct pic_fullcont *cont)
   pic->cc = cont->prev_jmp;
   pic->cp = cont->cp;
 
-  assert(pic->stend - pic->stbase >= cont->st_len);
+#if VM_PROFILE
+  pic_vm_prof_unwind(pic, pic->cibase);
+#endif
+
+  /* the stacks may have been moved or shrunk since the capture */
+  if (pic->stend - pic->stbase < cont->st_len) {
+    pic->stbase = pic_realloc(pic, pic->stbase, sizeof(pic_value) * cont->st_len);
+    pic->stend = pic->stbase + cont->st_len;
+  }
   memcpy(pic->stbase, cont->st_ptr, sizeof(pic_value) * cont->st_len);
   pic->sp = pic->stbase + cont->sp_offset;
-  pic->stend = pic->stbase + cont->st_len;
 
-  assert(pic->ciend - pic->cibase >= cont->ci_len);
+  if (pic->ciend - pic->cibase < cont->ci_len) {
+    pic->cibase = pic_realloc(pic, pic->cibase, sizeof(pic_callinfo) * cont->ci_len);
+    pic->ciend = pic->cibase + cont->ci_len;
+  }
   memcpy(pic->cibase, cont->ci_ptr, sizeof(pic_callinfo) * cont->ci_len);
   pic->ci = pic->cibase + cont->ci_offset;
-  pic->ciend = pic->cibase + cont->ci_len;
+
+  for (ci = pic->cibase; ci <= pic->ci; ++ci) {
+    ci->fp = pic->stbase + (ci->fp - cont->stbase);
+  }
+#if VM_PROFILE
+  pic_vm_prof_rewind(pic);
+#endif
+
+  pic_vm_reclaim_headroom(pic);
 
   assert(pic->xpend - pic->xpbase >= cont->xp_len);
   memcpy(pic->xpbase, cont->xp_ptr, sizeof(struct pic_proc *) * cont->xp_len);
@@ -19,6 +19,7 @@ pic_system_cmdline(pic_state *pic)
 
     v = pic_cons(pic, pic_obj_value(pic_make_str_cstr(pic, pic->argv[i])), v);
     pic_gc_arena_restore(pic, ai);
+    pic_gc_protect(pic, v);
   }
 
   return pic_reverse(pic, v);
@@ -0,0 +1,73 @@
+(import (scheme base)
+        (picrin test))
+
+(test-begin "override")
+
+;; the comparisons are inlined by the compiler; once one of them is
+;; redefined, calls through local operands and through arbitrary
+;; expressions must both reach the new definition, and only that one
+
+(define orig-< <)
+(define orig-<= <=)
+(define orig-> >)
+(define orig->= >=)
+
+(define (lt a b) (< a b))
+(define (le a b) (<= a b))
+(define (gt a b) (> a b))
+(define (ge a b) (>= a b))
+(define (lt* p) (< (car p) (cdr p)))
+(define (le* p) (<= (car p) (cdr p)))
+(define (gt* p) (> (car p) (cdr p)))
+(define (ge* p) (>= (car p) (cdr p)))
+
+(test #t (lt 1 2))
+(test #t (le 1 2))
+(test #f (gt 1 2))
+(test #f (ge 1 2))
+(test #t (lt* '(1 . 2)))
+(test #f (ge* '(1 . 2)))
+
+;; warm the callers up so that they are compiled to native code where
+;; PIC_JIT is enabled
+(let loop ((i 0))
+  (if (not (= i 2000))
+      (begin
+        (lt i 1) (le i 1) (gt i 1) (ge i 1)
+        (lt* '(1 . 2)) (le* '(1 . 2)) (gt* '(1 . 2)) (ge* '(1 . 2))
+        (loop (+ i 1)))))
+
+(set! < (lambda (a b) 'user-lt))
+(test 'user-lt (lt 1 2))
+(test 'user-lt (lt* '(1 . 2)))
+(test #t (le 1 2))
+(test #f (gt 1 2))
+(test #f (ge 1 2))
+(set! < orig-<)
+
+(set! <= (lambda (a b) 'user-le))
+(test 'user-le (le 1 2))
+(test 'user-le (le* '(1 . 2)))
+(test #t (lt 1 2))
+(test #f (gt* '(1 . 2)))
+(test #f (ge* '(1 . 2)))
+(set! <= orig-<=)
+
+(set! > (lambda (a b) 'user-gt))
+(test 'user-gt (gt 1 2))
+(test 'user-gt (gt* '(1 . 2)))
+(test #t (lt 1 2))
+(test #t (le* '(1 . 2)))
+(set! > orig->)
+
+(set! >= (lambda (a b) 'user-ge))
+(test 'user-ge (ge 1 2))
+(test 'user-ge (ge* '(1 . 2)))
+(test #t (lt* '(1 . 2)))
+(test #t (le 1 2))
+(set! >= orig->=)
+
+(test #t (lt 1 2))
+(test #f (gt* '(1 . 2)))
+
+(test-end)
@@ -122,6 +122,8 @@
 (test '(3 4 5 6) ((lambda x x) 3 4 5 6))
 (test '(5 6) ((lambda (x y . z) z)
  3 4 5 6))
+(test '(1 2 3 5 6) ((lambda (x . z) (apply list 1 2 x z)) 3 5 6))
+(test 'none ((lambda z (if (pair? z) (car z) 'none))))
 
 (test 'yes (if (> 3 2) 'yes 'no))
 (test 'no (if (> 2 3) 'yes 'no))
@@ -793,6 +795,10 @@
 (test -1 (- 3 4))
 (test -6 (- 3 4 5))
 (test -3 (- 3))
+(test (* 1073741824 2.0) (inexact (+ 2147483647 1)))
+(test (- (* 1073741824 -2.0) 1) (inexact (- (- 2147483647) 2)))
+(test (* 65536 65536.0) (inexact (* 65536 65536)))
+(test 3 (/ 6 2))
 ;; (test 3/20 (/ 3 4 5))
 ;; (test 1/3 (/ 3))
 
@@ -1384,6 +1390,9 @@
   (vector-set! vec 1 '("Sue" "Sue"))
   vec))
 
+(test #t (error-object? (guard (exn (else exn)) (vector-ref '(1 2) 0))))
+(test #t (error-object? (guard (exn (else exn)) (vector-ref '#(1 2)))))
+
 (test '(dah dah didah) (vector->list '#(dah dah didah)))
 (test '(dah didah) (vector->list '#(dah dah didah) 1))
 (test '(dah) (vector->list '#(dah dah didah) 1 2))
@@ -1575,6 +1584,8 @@
 
 (test #(5 7 9) (vector-map + '#(1 2 3) '#(4 5 6 7)))
 
+(test #(-3 -3 -3) (vector-map - '#(1 2 3) '#(4 5 6 7)))
+
 (test #t
     (let ((res (let ((count 0))
                  (vector-map
@@ -1823,6 +1834,13 @@
                ((assq 'b condition)))
          (raise (list (cons 'd 24)))))))
 
+(let ()
+  (define (count n) (if (= n 0) 0 (+ 1 (count (- n 1)))))
+  (define (loop n) (+ 1 (loop n)))
+  (test 100000 (count 100000))
+  (test #t (error-object? (guard (exn (else exn)) (loop 0))))
+  (test #t (error-object? (guard (exn (else exn)) (loop 0)))))
+
 (test-end)
 
 (test-begin "6.12 Environments and evaluation")
@@ -0,0 +1,8 @@
+CONTRIB_INITS += gc
+CONTRIB_SRCS += $(wildcard contrib/30.gc/src/*.c)
+CONTRIB_TESTS += test-gc
+
+test-gc: bin/picrin
+	for test in `ls contrib/30.gc/t/*.scm`; do \
+	  $(TEST_RUNNER) $$test; \
+	done
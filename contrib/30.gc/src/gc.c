@@ -0,0 +1,189 @@
+/**
+ * See Copyright Notice in picrin.h
+ */
+
+#include "picrin.h"
+
+/* counters may not fit in a fixnum */
+static pic_value
+size_value(size_t n)
+{
+  if (n <= INT_MAX) {
+    return pic_int_value((int)n);
+  }
+  return pic_float_value((double)n);
+}
+
+static pic_value
+entry(pic_state *pic, const char *name, pic_value v)
+{
+  return pic_cons(pic, pic_obj_value(pic_intern(pic, name)), v);
+}
+
+static pic_value
+pic_gc_statistics(pic_state *pic)
+{
+  struct pic_gc_stats stats;
+  pic_value objects = pic_nil_value(), r = pic_nil_value();
+  int i;
+
+  pic_get_args(pic, "");
+
+  pic_gc_stats(pic, &stats);
+
+  for (i = PIC_TT_CP; i >= PIC_TT_SYMBOL; --i) {
+    objects = pic_cons(pic, entry(pic, pic_type_repr(i), size_value(stats.objects[i])), objects);
+  }
+
+  r = pic_cons(pic, entry(pic, "objects", objects), r);
+  r = pic_cons(pic, entry(pic, "finalized", size_value(stats.finalized)), r);
+  r = pic_cons(pic, entry(pic, "pages", size_value(stats.pages)), r);
+  r = pic_cons(pic, entry(pic, "live", size_value(stats.live)), r);
+  r = pic_cons(pic, entry(pic, "allocated", size_value(stats.allocated)), r);
+  r = pic_cons(pic, entry(pic, "last-pause", pic_float_value(stats.last_pause / 1e6)), r);
+  r = pic_cons(pic, entry(pic, "total-pause", pic_float_value(stats.total_pause / 1e6)), r);
+  r = pic_cons(pic, entry(pic, "major-collections", size_value(stats.major_collections)), r);
+  r = pic_cons(pic, entry(pic, "collections", size_value(stats.collections)), r);
+  return r;
+}
+
+static pic_value
+pic_gc_collect(pic_state *pic)
+{
+  pic_get_args(pic, "");
+
+  pic_gc_run(pic);
+
+  return pic_undef_value();
+}
+
+static pic_value
+pic_gc_collect_step(pic_state *pic)
+{
+  int budget = PIC_GC_STEP_BUDGET;
+
+  pic_get_args(pic, "|i", &budget);
+
+  if (budget < 0) {
+    pic_errorf(pic, "gc-step: budget must not be negative, but got %d", budget);
+  }
+
+  return pic_bool_value(pic_gc_step(pic, (size_t)budget));
+}
+
+static pic_value
+pic_gc_profile_start(pic_state *pic)
+{
+  int interval = 4096;
+
+  pic_get_args(pic, "|i", &interval);
+
+  if (interval <= 0) {
+    pic_errorf(pic, "gc-profile-start: interval must be positive, but got %d", interval);
+  }
+  pic_prof_start(pic, interval);
+
+  return pic_undef_value();
+}
+
+static pic_value
+pic_gc_profile_stop(pic_state *pic)
+{
+  pic_get_args(pic, "");
+
+  pic_prof_stop(pic);
+
+  return pic_undef_value();
+}
+
+static pic_value
+pic_gc_profile_report(pic_state *pic)
+{
+  struct pic_port *port = pic_stdout(pic);
+
+  pic_get_args(pic, "|p", &port);
+
+  pic_prof_report(pic, port->file);
+
+  return pic_undef_value();
+}
+
+static pic_value
+guardian_call(pic_state *pic)
+{
+  struct pic_proc *self = pic_get_proc(pic);
+  pic_value guardian, obj;
+  int n;
+
+  n = pic_get_args(pic, "|o", &obj);
+
+  guardian = pic_proc_env_ref(pic, self, "guardian");
+
+  if (n == 0) {
+    return pic_guardian_poll(pic, guardian);
+  }
+  pic_guardian_add(pic, guardian, obj);
+  return pic_undef_value();
+}
+
+static pic_value
+pic_gc_make_guardian(pic_state *pic)
+{
+  struct pic_proc *proc;
+
+  pic_get_args(pic, "");
+
+  proc = pic_make_proc(pic, guardian_call);
+
+  pic_proc_env_set(pic, proc, "guardian", pic_make_guardian(pic));
+
+  return pic_obj_value(proc);
+}
+
+/* raises the error message it was made with, if any */
+static void
+probe_dtor(pic_state *pic, void *data)
+{
+  pic_str *msg;
+
+  if (data == NULL) {
+    return;
+  }
+  msg = pic_make_str_cstr(pic, data);
+  pic_free(pic, data);
+  pic_errorf(pic, "~a", pic_obj_value(msg));
+}
+
+static const pic_data_type probe_type = { "finalizer-probe", probe_dtor, NULL };
+
+static pic_value
+pic_gc_make_finalizer_probe(pic_state *pic)
+{
+  pic_str *msg = NULL;
+  const char *cstr;
+  char *data = NULL;
+
+  pic_get_args(pic, "|s", &msg);
+
+  if (msg != NULL) {
+    cstr = pic_str_cstr(pic, msg);
+    data = pic_malloc(pic, strlen(cstr) + 1);
+    strcpy(data, cstr);
+  }
+  return pic_obj_value(pic_data_alloc(pic, &probe_type, data));
+}
+
+void
+pic_init_gc(pic_state *pic)
+{
+  pic_deflibrary (pic, "(picrin gc)") {
+    pic_defun(pic, "gc-collect", pic_gc_collect);
+    pic_defun(pic, "gc-step", pic_gc_collect_step);
+    pic_defun(pic, "gc-statistics", pic_gc_statistics);
+    pic_defun(pic, "make-guardian", pic_gc_make_guardian);
+    pic_defun(pic, "make-finalizer-probe", pic_gc_make_finalizer_probe);
+    pic_defun(pic, "gc-profile-start", pic_gc_profile_start);
+    pic_defun(pic, "gc-profile-stop", pic_gc_profile_stop);
+    pic_defun(pic, "gc-profile-report", pic_gc_profile_report);
+  }
+}
@@ -0,0 +1,106 @@
+(import (scheme base)
+        (picrin base)
+        (picrin gc)
+        (picrin test))
+
+(define (stat name)
+  (cdr (assq name (gc-statistics))))
+
+(define n (stat 'collections))
+
+(define v (make-vector 100 (list 1 2 3)))
+
+(gc-collect)
+
+(test #t (> (stat 'collections) n))
+(test #t (> (stat 'major-collections) 0))
+(test #t (> (stat 'allocated) (stat 'live)))
+(test #t (> (stat 'pages) 0))
+(test #t (>= (stat 'total-pause) (stat 'last-pause)))
+(test #t (> (cdr (assq 'pair (stat 'objects))) 0))
+(test #t (> (cdr (assq 'vector (stat 'objects))) 0))
+(test #t (> (cdr (assq 'irep (stat 'objects))) 0))
+
+(define (make-list-of n) (if (= n 0) '() (cons n (make-list-of (- n 1)))))
+
+(gc-profile-start 64)
+(make-list-of 100)
+(define out (open-output-string))
+(gc-profile-report out)
+(gc-profile-stop)
+
+(test #t (> (string-length (get-output-string out)) 0))
+
+;; registry values that are keys of the same registry are kept by the chain
+(define r (make-register))
+(define k (list 'k))
+
+(let loop ((i 0) (key k))
+  (if (< i 1000)
+      (let ((next (list i)))
+        (r key next)
+        (loop (+ i 1) next))))
+
+(gc-collect)
+
+(define (walk key count)
+  (let ((entry (r key)))
+    (if entry
+        (walk (cdr entry) (+ count 1))
+        count)))
+
+(test 1000 (walk k 0))
+
+;; guardians hand unreachable objects back instead of letting them go
+(define g (make-guardian))
+(define kept (list 'kept))
+
+(g kept)
+(g (list 'dropped))
+
+(gc-collect)
+
+(test '(dropped) (g))
+(test #f (g))
+
+(set! kept #f)
+(gc-collect)
+
+(test '(kept) (g))
+
+;; an incremental collection can be driven to its end a step at a time
+(define (steps budget)
+  (let loop ((n 1))
+    (if (gc-step budget)
+        n
+        (loop (+ n 1)))))
+
+(define m (stat 'major-collections))
+
+(test #t (> (steps 16) 1))
+(test #t (> (stat 'major-collections) m))
+(test #t (> (steps 0) 1))
+(test 1000 (walk k 0))
+
+;; an error raised by a destructor does not stop the later ones
+(define probes
+  (list (make-finalizer-probe) (make-finalizer-probe "probe failed") (make-finalizer-probe)))
+
+(define f (stat 'finalized))
+
+(test "probe failed"
+      (guard (e (#t (error-object-message e)))
+        (set! probes #f)
+        (gc-collect)
+        #f))
+
+(gc-collect)
+
+(test #t (>= (- (stat 'finalized) f) 3))
+
+(define probe (make-finalizer-probe))
+(define f2 (stat 'finalized))
+(set! probe #f)
+(gc-collect)
+
+(test #t (> (stat 'finalized) f2))
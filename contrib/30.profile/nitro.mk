@@ -0,0 +1,8 @@
+CONTRIB_INITS += profile
+CONTRIB_SRCS += $(wildcard contrib/30.profile/src/*.c)
+CONTRIB_TESTS += test-profile
+
+test-profile: bin/picrin
+	for test in `ls contrib/30.profile/t/*.scm`; do \
+	  $(TEST_RUNNER) $$test; \
+	done
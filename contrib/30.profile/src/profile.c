@@ -0,0 +1,84 @@
+/**
+ * See Copyright Notice in picrin.h
+ */
+
+#include "picrin.h"
+
+static pic_value
+pic_profile_reset(pic_state *pic)
+{
+  pic_get_args(pic, "");
+
+#if VM_PROFILE
+  pic_vm_prof_reset(pic);
+#else
+  pic_errorf(pic, "profile-reset: picrin is built without VM_PROFILE");
+#endif
+
+  return pic_undef_value();
+}
+
+static pic_value
+pic_profile_report(pic_state *pic)
+{
+  struct pic_port *port = pic_stdout(pic);
+
+  pic_get_args(pic, "|p", &port);
+
+#if VM_PROFILE
+  pic_vm_prof_report(pic, port->file);
+#else
+  pic_errorf(pic, "profile-report: picrin is built without VM_PROFILE");
+#endif
+
+  return pic_undef_value();
+}
+
+static pic_value
+pic_profile_sample_start(pic_state *pic)
+{
+  int usec = 1000;
+
+  pic_get_args(pic, "|i", &usec);
+
+  if (usec <= 0) {
+    pic_errorf(pic, "profile-sample-start: interval must be positive, but got %d", usec);
+  }
+  pic_prof_start_timer(pic, usec);
+
+  return pic_undef_value();
+}
+
+static pic_value
+pic_profile_sample_stop(pic_state *pic)
+{
+  pic_get_args(pic, "");
+
+  pic_prof_stop(pic);
+
+  return pic_undef_value();
+}
+
+static pic_value
+pic_profile_sample_report(pic_state *pic)
+{
+  struct pic_port *port = pic_stdout(pic);
+
+  pic_get_args(pic, "|p", &port);
+
+  pic_prof_report(pic, port->file);
+
+  return pic_undef_value();
+}
+
+void
+pic_init_profile(pic_state *pic)
+{
+  pic_deflibrary (pic, "(picrin profile)") {
+    pic_defun(pic, "profile-reset", pic_profile_reset);
+    pic_defun(pic, "profile-report", pic_profile_report);
+    pic_defun(pic, "profile-sample-start", pic_profile_sample_start);
+    pic_defun(pic, "profile-sample-stop", pic_profile_sample_stop);
+    pic_defun(pic, "profile-sample-report", pic_profile_sample_report);
+  }
+}
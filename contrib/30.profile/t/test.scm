@@ -0,0 +1,48 @@
+(import (scheme base)
+        (picrin profile)
+        (picrin test))
+
+(define (fib n)
+  (if (< n 2)
+      n
+      (+ (fib (- n 1)) (fib (- n 2)))))
+
+(define (report)
+  (let ((out (open-output-string)))
+    (profile-report out)
+    (get-output-string out)))
+
+(define (contains? str sub)
+  (let loop ((i 0))
+    (cond ((> (+ i (string-length sub)) (string-length str)) #f)
+          ((string=? sub (substring str i (+ i (string-length sub)))) #t)
+          (else (loop (+ i 1))))))
+
+(define profiled
+  (guard (e (#t #f))
+    (profile-reset)
+    #t))
+
+(when profiled
+  (fib 15)
+  (let ((r (report)))
+    (test #t (contains? r "fib"))
+    (test #t (contains? r "CALL")))
+  (profile-reset)
+  (test #f (contains? (report) "fib")))
+
+(define (sample-report)
+  (let ((out (open-output-string)))
+    (profile-sample-report out)
+    (get-output-string out)))
+
+(define sampled
+  (guard (e (#t #f))
+    (profile-sample-start 100)
+    #t))
+
+(when sampled
+  (fib 25)
+  (test #t (contains? (sample-report) "fib"))
+  (profile-sample-stop)
+  (test "" (sample-report)))
@@ -0,0 +1,45 @@
+(import (scheme base)
+        (scheme time)
+        (scheme write))
+
+(define (time f)
+  (let ((start (current-jiffy)))
+    (f)
+    (inexact
+     (/ (- (current-jiffy) start)
+        (jiffies-per-second)))))
+
+(define (fib n)
+  (if (< n 2)
+      n
+      (+ (fib (- n 1)) (fib (- n 2)))))
+
+(define (tak x y z)
+  (if (> x y)
+      (tak (tak (- x 1) y z)
+	   (tak (- y 1) z x)
+	   (tak (- z 1) x y))
+      y))
+
+(define (loop n)
+  (let loop ((i 0) (acc 0))
+    (if (< i n)
+        (loop (+ i 1) (- (+ acc (* i 3)) (+ (* i 3) 1)))
+        acc)))
+
+(for-each
+ (lambda (bench)
+   (write-string (car bench))
+   (write-string " ")
+   (write-simple (time (cdr bench)))
+   (newline))
+ (list (cons "fib" (lambda () (fib 30)))
+       (cons "tak" (lambda () (tak 18 12 6)))
+       (cons "loop" (lambda () (loop 3000000)))))
+
+; int arithmetic through double, nan-boxing -> fib 0.154 tak 0.757 loop 0.334
+;                                   unboxed -> fib 0.139 tak 0.706 loop 0.328
+;                              word-boxing -> fib 0.148 tak 0.676 loop 0.304
+; overflow-checked int fast paths, nan-boxing -> fib 0.131 tak 0.711 loop 0.287
+;                                     unboxed -> fib 0.142 tak 0.710 loop 0.295
+;                                word-boxing -> fib 0.109 tak 0.560 loop 0.297
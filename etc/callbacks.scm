@@ -0,0 +1,39 @@
+(import (scheme base)
+        (scheme time)
+        (scheme write))
+
+(define (time f)
+  (let ((start (current-jiffy)))
+    (f)
+    (inexact
+     (/ (- (current-jiffy) start)
+        (jiffies-per-second)))))
+
+(define xs (make-list 100000 1))
+(define v (make-vector 100000 1))
+(define s (make-string 100000 #\a))
+
+;; the callbacks are primitives, so that the time goes into calling them
+(define (repeat thunk)
+  (lambda ()
+    (let loop ((i 0))
+      (if (< i 20)
+          (begin
+            (thunk)
+            (loop (+ i 1)))))))
+
+(for-each
+ (lambda (bench)
+   (write-string (car bench))
+   (write-string " ")
+   (write-simple (time (repeat (cdr bench))))
+   (newline))
+ (list (cons "for-each" (lambda () (for-each + xs)))
+       (cons "map" (lambda () (map + xs xs)))
+       (cons "vector-for-each" (lambda () (vector-for-each + v)))
+       (cons "vector-map" (lambda () (vector-map + v v)))
+       (cons "string-for-each" (lambda () (string-for-each char->integer s)))))
+
+; consed argument lists     -> for-each 0.493 map 0.978 vector-for-each 0.377 vector-map 0.585 string-for-each 0.416
+; reused argument vector    -> for-each 0.063 map 0.298 vector-for-each 0.058 vector-map 0.086 string-for-each 0.064
+; arguments on the VM stack -> for-each 0.075 map 0.330 vector-for-each 0.077 vector-map 0.102 string-for-each 0.077
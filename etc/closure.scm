@@ -0,0 +1,67 @@
+(import (scheme base)
+        (scheme time)
+        (scheme write))
+
+(define (time f)
+  (let ((start (current-jiffy)))
+    (f)
+    (inexact
+     (/ (- (current-jiffy) start)
+        (jiffies-per-second)))))
+
+;; free variables several levels up
+(define (nested a)
+  (lambda (b)
+    (lambda (c)
+      (lambda (d)
+        (+ a b c d)))))
+
+(define (deep n)
+  (let ((f (((nested 1) 2) 3)))
+    (let loop ((i 0) (acc 0))
+      (if (= i n)
+          acc
+          (loop (+ i 1) (+ acc (f i)))))))
+
+;; an assigned captured variable
+(define (make-counter)
+  (let ((n 0))
+    (lambda ()
+      (set! n (+ n 1))
+      n)))
+
+(define (count n)
+  (let ((c (make-counter)))
+    (let loop ((i 0))
+      (if (< i n)
+          (begin (c) (loop (+ i 1)))
+          (c)))))
+
+;; a local loop entered many times
+(define (sum-to n)
+  (let loop ((i 0) (acc 0))
+    (if (> i n)
+        acc
+        (loop (+ i 1) (+ acc i)))))
+
+(define (sums n)
+  (let loop ((i 0) (acc 0))
+    (if (= i n)
+        acc
+        (loop (+ i 1) (+ acc (sum-to 3))))))
+
+;; closure creation
+(define (compose* n)
+  (let loop ((i 0) (f (lambda (x) x)))
+    (if (= i n)
+        (f 0)
+        (loop (+ i 1) (let ((g f)) (lambda (x) (g x)))))))
+
+(write-simple (time (lambda () (deep 1000000))))
+(newline)
+(write-simple (time (lambda () (count 1000000))))
+(newline)
+(write-simple (time (lambda () (sums 1000000))))
+(newline)
+(write-simple (time (lambda () (compose* 100000))))
+(newline)
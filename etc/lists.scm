@@ -0,0 +1,78 @@
+(import (scheme base)
+        (scheme time)
+        (scheme write))
+
+(define (time f)
+  (let ((start (current-jiffy)))
+    (f)
+    (inexact
+     (/ (- (current-jiffy) start)
+        (jiffies-per-second)))))
+
+(define (iota* n)
+  (let loop ((i (- n 1)) (acc '()))
+    (if (< i 0)
+        acc
+        (loop (- i 1) (cons i acc)))))
+
+(define (my-map f xs)
+  (if (null? xs)
+      '()
+      (cons (f (car xs)) (my-map f (cdr xs)))))
+
+(define (my-filter p xs)
+  (cond ((null? xs) '())
+        ((p (car xs)) (cons (car xs) (my-filter p (cdr xs))))
+        (else (my-filter p (cdr xs)))))
+
+(define (my-fold f acc xs)
+  (if (null? xs)
+      acc
+      (my-fold f (f (car xs) acc) (cdr xs))))
+
+(define (my-reverse xs)
+  (my-fold cons '() xs))
+
+(define (my-length xs)
+  (let loop ((xs xs) (n 0))
+    (if (null? xs)
+        n
+        (loop (cdr xs) (+ n 1)))))
+
+(define (my-assq k alist)
+  (cond ((null? alist) #f)
+        ((eq? k (car (car alist))) (car alist))
+        (else (my-assq k (cdr alist)))))
+
+(define (qsort xs)
+  (if (null? xs)
+      '()
+      (let ((p (car xs)) (rest (cdr xs)))
+        (append (qsort (my-filter (lambda (x) (< x p)) rest))
+                (list p)
+                (qsort (my-filter (lambda (x) (>= x p)) rest))))))
+
+(define (scramble n)
+  (let loop ((i 0) (x 1) (acc '()))
+    (if (= i n)
+        acc
+        (loop (+ i 1) (modulo (+ (* x 1103) 12345) 65536) (cons x acc)))))
+
+(define (run)
+  (let ((xs (iota* 200))
+        (al (my-map (lambda (i) (cons i i)) (iota* 100))))
+    (let loop ((k 0) (s 0))
+      (if (< k 1000)
+          (loop (+ k 1)
+                (+ s
+                   (my-length (my-reverse (my-map (lambda (x) (+ x 1)) xs)))
+                   (my-fold + 0 (my-filter (lambda (x) (< x 100)) xs))
+                   (cdr (my-assq 99 al))
+                   (my-length (qsort (scramble 100)))))
+          s))))
+
+(write-simple (time run))
+(newline)
+
+; one dispatch per instruction -> 0.377
+; superinstructions            -> 0.239
@@ -0,0 +1,49 @@
+(import (scheme base)
+        (scheme time)
+        (scheme write))
+
+(define (time f)
+  (let ((start (current-jiffy)))
+    (f)
+    (inexact
+     (/ (- (current-jiffy) start)
+        (jiffies-per-second)))))
+
+(define (vector-sum! v)
+  (let loop ((i 0) (s 0))
+    (if (= i (vector-length v))
+        s
+        (begin
+          (vector-set! v i (+ (vector-ref v i) 1))
+          (loop (+ i 1) (+ s (vector-ref v i)))))))
+
+(define (string-checksum str)
+  (let loop ((i 0) (s 0))
+    (if (= i (string-length str))
+        s
+        (loop (+ i 1) (+ s (char->integer (string-ref str i)))))))
+
+(define (count-eq x xs)
+  (let loop ((xs xs) (n 0))
+    (if (null? xs)
+        n
+        (loop (cdr xs) (if (eq? x (car xs)) (+ n 1) n)))))
+
+(define (run)
+  (let ((v (make-vector 1000 0))
+        (str (make-string 1000 #\a))
+        (xs (make-list 1000 'a)))
+    (let loop ((k 0) (s 0))
+      (if (< k 300)
+          (loop (+ k 1)
+                (+ s
+                   (vector-sum! v)
+                   (string-checksum str)
+                   (count-eq 'a xs)))
+          s))))
+
+(write-simple (time run))
+(newline)
+
+; pic_get_args     -> 0.114
+; pic_defun_spec   -> 0.100
@@ -0,0 +1,43 @@
+(import (scheme base)
+        (scheme time)
+        (scheme write))
+
+(define (time f)
+  (let ((start (current-jiffy)))
+    (f)
+    (inexact
+     (/ (- (current-jiffy) start)
+        (jiffies-per-second)))))
+
+(define (add3 a b c)
+  (+ a b c))
+
+;; forwarding wrapper
+(define (traced f . args)
+  (apply f args))
+
+;; optional argument idiom
+(define (inc x . step)
+  (+ x (if (null? step) 1 (car step))))
+
+;; the rest list itself is returned
+(define (collect . xs)
+  xs)
+
+(define (run)
+  (let loop ((i 0) (s 0))
+    (if (< i 300000)
+        (loop (+ i 1)
+              (+ s
+                 (traced add3 i 1 2)
+                 (inc i)
+                 (inc i 2)
+                 (car (collect i 1 2))
+                 (apply add3 1 2 (list i))))
+        s)))
+
+(write-simple (time run))
+(newline)
+
+; consed rest lists -> 0.232
+; on demand         -> 0.161
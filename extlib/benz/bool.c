@@ -119,7 +119,8 @@ pic_bool_eq_p(pic_state *pic)
 {
   pic_value x, y;
 
-  pic_get_args(pic, "oo", &x, &y);
+  x = pic_arg(pic, 0);
+  y = pic_arg(pic, 1);
 
   return pic_bool_value(pic_eq_p(x, y));
 }
@@ -129,7 +130,8 @@ pic_bool_eqv_p(pic_state *pic)
 {
   pic_value x, y;
 
-  pic_get_args(pic, "oo", &x, &y);
+  x = pic_arg(pic, 0);
+  y = pic_arg(pic, 1);
 
   return pic_bool_value(pic_eqv_p(x, y));
 }
@@ -139,7 +141,8 @@ pic_bool_equal_p(pic_state *pic)
 {
   pic_value x, y;
 
-  pic_get_args(pic, "oo", &x, &y);
+  x = pic_arg(pic, 0);
+  y = pic_arg(pic, 1);
 
   return pic_bool_value(pic_equal_p(pic, x, y));
 }
@@ -149,7 +152,7 @@ pic_bool_not(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_false_p(v) ? pic_true_value() : pic_false_value();
 }
@@ -159,7 +162,7 @@ pic_bool_boolean_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return (pic_true_p(v) || pic_false_p(v)) ? pic_true_value() : pic_false_value();
 }
@@ -186,12 +189,12 @@ pic_bool_boolean_eq_p(pic_state *pic)
 void
 pic_init_bool(pic_state *pic)
 {
-  pic_defun(pic, "eq?", pic_bool_eq_p);
-  pic_defun(pic, "eqv?", pic_bool_eqv_p);
-  pic_defun(pic, "equal?", pic_bool_equal_p);
+  pic_defun_spec(pic, "eq?", pic_bool_eq_p, "oo");
+  pic_defun_spec(pic, "eqv?", pic_bool_eqv_p, "oo");
+  pic_defun_spec(pic, "equal?", pic_bool_equal_p, "oo");
 
-  pic_defun(pic, "not", pic_bool_not);
+  pic_defun_spec(pic, "not", pic_bool_not, "o");
 
-  pic_defun(pic, "boolean?", pic_bool_boolean_p);
+  pic_defun_spec(pic, "boolean?", pic_bool_boolean_p, "o");
   pic_defun(pic, "boolean=?", pic_bool_boolean_eq_p);
 }
@@ -9,7 +9,7 @@ pic_char_char_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_char_p(v) ? pic_true_value() : pic_false_value();
 }
@@ -19,7 +19,7 @@ pic_char_char_to_integer(pic_state *pic)
 {
   char c;
 
-  pic_get_args(pic, "c", &c);
+  c = pic_char(pic_arg(pic, 0));
 
   return pic_int_value(c);
 }
@@ -29,7 +29,7 @@ pic_char_integer_to_char(pic_state *pic)
 {
   int i;
 
-  pic_get_args(pic, "i", &i);
+  i = pic_int(pic_arg(pic, 0));
 
   if (i < 0 || i > 127) {
     pic_errorf(pic, "integer->char: integer out of char range: %d", i);
@@ -74,9 +74,9 @@ DEFINE_CHAR_CMP(>=, ge)
 void
 pic_init_char(pic_state *pic)
 {
-  pic_defun(pic, "char?", pic_char_char_p);
-  pic_defun(pic, "char->integer", pic_char_char_to_integer);
-  pic_defun(pic, "integer->char", pic_char_integer_to_char);
+  pic_defun_spec(pic, "char?", pic_char_char_p, "o");
+  pic_defun_spec(pic, "char->integer", pic_char_char_to_integer, "c");
+  pic_defun_spec(pic, "integer->char", pic_char_integer_to_char, "i");
   pic_defun(pic, "char=?", pic_char_eq_p);
   pic_defun(pic, "char<?", pic_char_lt_p);
   pic_defun(pic, "char>?", pic_char_gt_p);
@@ -359,27 +359,62 @@ pic_optimize(pic_state *pic, pic_value expr)
 
 KHASH_DECLARE(a, pic_sym *, int)
 KHASH_DEFINE2(a, pic_sym *, int, 0, kh_ptr_hash_func, kh_ptr_hash_equal)
+KHASH_DECLARE(d, pic_sym *, int)
+KHASH_DEFINE2(d, pic_sym *, int, 1, kh_ptr_hash_func, kh_ptr_hash_equal)
 
 /**
  * TODO: don't use khash_t, use kvec_t instead
  */
 
+/**
+ * Closures are flat. Each lambda lists its free variables, whose values are
+ * copied into the closure when it is created; a lambda nested in between
+ * the reference and the binding carries the variable along as well. The
+ * copies must not diverge, so a captured variable lives in a box when it
+ * may change after being copied: when it is the target of set! or defined
+ * twice, or when a closure is created before its definition is done. A
+ * lambda that is the value of a definition refers to the defined variable
+ * as itself, which is found at the bottom of its frame.
+ *
+ * A local procedure that never escapes, that is whose name appears only as
+ * the operator of calls with the right number of arguments, made from the
+ * scope itself or from its own body, is lambda-lifted: its free variables
+ * are passed as extra arguments and the closure becomes a constant, so
+ * loops and helpers cost no allocation.
+ *
+ * The rest list of a lambda is made on demand, see codegen_rest, unless
+ * the rest variable is captured, assigned or defined over.
+ */
+
 typedef struct analyze_scope {
   int depth;
   pic_sym *rest;                     /* Nullable */
+  pic_sym *self;                     /* Nullable */
   khash_t(a) args, locals, captures; /* rest args variable is counted as a local */
+  khash_t(a) sets;                   /* variables changing after a capture */
+  khash_t(d) defs;                   /* definitions, mapped to when they are done */
+  khash_t(a) frees;                  /* free variables */
+  khash_t(a) escapes;                /* variables referred to other than by known calls */
+  khash_t(d) calls;                  /* arity of the known calls */
+  int time;                          /* clock of definitions and closures */
   pic_value defer;
+  pic_value lifts;                   /* lifted procedures, mapped to their lambdas */
   struct analyze_scope *up;
 } analyze_scope;
 
 static void
-analyzer_scope_init(pic_state *pic, analyze_scope *scope, pic_value formal, analyze_scope *up)
+analyzer_scope_init(pic_state *pic, analyze_scope *scope, pic_value formal, pic_sym *self, analyze_scope *up)
 {
   int ret;
 
   kh_init(a, &scope->args);
   kh_init(a, &scope->locals);
   kh_init(a, &scope->captures);
+  kh_init(a, &scope->sets);
+  kh_init(d, &scope->defs);
+  kh_init(a, &scope->frees);
+  kh_init(a, &scope->escapes);
+  kh_init(d, &scope->calls);
 
   /* analyze formal */
   for (; pic_pair_p(formal); formal = pic_cdr(pic, formal)) {
@@ -393,9 +428,12 @@ analyzer_scope_init(pic_state *pic, analyze_scope *scope, pic_value formal, anal
     kh_put(a, &scope->locals, pic_sym_ptr(formal), &ret);
   }
 
+  scope->self = self;
+  scope->time = 0;
   scope->up = up;
   scope->depth = up ? up->depth + 1 : 0;
   scope->defer = pic_list1(pic, pic_nil_value());
+  scope->lifts = pic_list1(pic, pic_nil_value());
 }
 
 static void
@@ -404,6 +442,11 @@ analyzer_scope_destroy(pic_state *pic, analyze_scope *scope)
   kh_destroy(a, &scope->args);
   kh_destroy(a, &scope->locals);
   kh_destroy(a, &scope->captures);
+  kh_destroy(a, &scope->sets);
+  kh_destroy(d, &scope->defs);
+  kh_destroy(a, &scope->frees);
+  kh_destroy(a, &scope->escapes);
+  kh_destroy(d, &scope->calls);
 }
 
 static bool
@@ -415,21 +458,116 @@ search_scope(analyze_scope *scope, pic_sym *sym)
 static int
 find_var(pic_state *pic, analyze_scope *scope, pic_sym *sym)
 {
+  analyze_scope *s = scope;
   int depth = 0, ret;
 
-  while (scope) {
-    if (search_scope(scope, sym)) {
-      if (depth > 0) {
-        kh_put(a, &scope->captures, sym, &ret); /* capture! */
+  while (s) {
+    if (search_scope(s, sym) || s->self == sym) {
+      if (depth > 0 && s->depth > 0) {
+        kh_put(a, &s->captures, sym, &ret); /* capture! */
+        for (; scope != s; scope = scope->up) {
+          kh_put(a, &scope->frees, sym, &ret);
+        }
       }
       return depth;
     }
     depth++;
-    scope = scope->up;
+    s = s->up;
   }
   PIC_UNREACHABLE();
 }
 
+static bool
+lambda_form_p(pic_state *pic, pic_value obj)
+{
+  return pic_pair_p(obj) && pic_eq_p(pic_car(pic, obj), pic_obj_value(pic->uLAMBDA));
+}
+
+/**
+ * Collect the targets of set! in the body, nested lambdas included, the
+ * definitions of the scope itself, and how the names are referred to. A
+ * call is known when it is made from the scope itself or from the body of
+ * the lambda bound to the called name (owner). Shadowed names are taken
+ * for the same variable, which at worst boxes or escapes one too many.
+ */
+static void
+scan_body(pic_state *pic, analyze_scope *scope, pic_value obj, pic_sym *owner, bool nested)
+{
+  pic_value elt, val, it;
+  pic_sym *sym;
+  khiter_t k;
+  int ret;
+
+  if (pic_sym_p(obj)) {
+    kh_put(a, &scope->escapes, pic_sym_ptr(obj), &ret);
+    return;
+  }
+  if (! pic_pair_p(obj)) {
+    return;
+  }
+  if (pic_sym_p(pic_car(pic, obj))) {
+    sym = pic_sym_ptr(pic_car(pic, obj));
+    if (sym == pic->uQUOTE) {
+      return;
+    }
+    if (sym == pic->uSETBANG) {
+      kh_put(a, &scope->sets, pic_sym_ptr(pic_list_ref(pic, obj, 1)), &ret);
+      scan_body(pic, scope, pic_list_ref(pic, obj, 2), owner, nested);
+      return;
+    }
+    if (sym == pic->uDEFINE) {
+      sym = pic_sym_ptr(pic_list_ref(pic, obj, 1));
+      val = pic_list_ref(pic, obj, 2);
+      if (nested) {
+        scan_body(pic, scope, val, owner, nested);
+        return;
+      }
+      k = kh_put(d, &scope->defs, sym, &ret);
+      if (ret == 0) {
+        kh_put(a, &scope->sets, sym, &ret);
+      }
+      kh_val(&scope->defs, k) = INT_MAX;
+      if (lambda_form_p(pic, val)) {
+        pic_for_each (elt, pic_cddr(pic, val), it) {
+          scan_body(pic, scope, elt, sym, true);
+        }
+      } else {
+        scan_body(pic, scope, val, owner, nested);
+      }
+      return;
+    }
+    if (sym == pic->uLAMBDA) {
+      pic_for_each (elt, pic_cddr(pic, obj), it) { /* formals may be dotted */
+        scan_body(pic, scope, elt, NULL, true);
+      }
+      return;
+    }
+    if (sym == pic->uBEGIN || sym == pic->uIF) {
+      pic_for_each (elt, pic_cdr(pic, obj), it) {
+        scan_body(pic, scope, elt, owner, nested);
+      }
+      return;
+    }
+
+    /* call by name */
+    if (nested && owner != sym) {
+      kh_put(a, &scope->escapes, sym, &ret);
+    } else {
+      k = kh_put(d, &scope->calls, sym, &ret);
+      if (ret != 0) {
+        kh_val(&scope->calls, k) = pic_length(pic, pic_cdr(pic, obj));
+      }
+      else if (kh_val(&scope->calls, k) != pic_length(pic, pic_cdr(pic, obj))) {
+        kh_put(a, &scope->escapes, sym, &ret);
+      }
+    }
+    obj = pic_cdr(pic, obj);
+  }
+  pic_for_each (elt, obj, it) {
+    scan_body(pic, scope, elt, owner, nested);
+  }
+}
+
 static void
 define_var(pic_state *pic, analyze_scope *scope, pic_sym *sym)
 {
@@ -446,12 +584,13 @@ define_var(pic_state *pic, analyze_scope *scope, pic_sym *sym)
 }
 
 static pic_value analyze(pic_state *, analyze_scope *, pic_value);
-static pic_value analyze_lambda(pic_state *, analyze_scope *, pic_value);
+static pic_value analyze_lambda(pic_state *, analyze_scope *, pic_value, pic_sym *);
 
 #define GREF pic_intern(pic, "gref")
 #define LREF pic_intern(pic, "lref")
 #define CREF pic_intern(pic, "cref")
 #define CALL pic_intern(pic, "call")
+#define LCALL pic_intern(pic, "lcall")
 
 static pic_value
 analyze_var(pic_state *pic, analyze_scope *scope, pic_sym *sym)
@@ -470,11 +609,14 @@ analyze_var(pic_state *pic, analyze_scope *scope, pic_sym *sym)
 }
 
 static pic_value
-analyze_defer(pic_state *pic, analyze_scope *scope, pic_value form)
+analyze_defer(pic_state *pic, analyze_scope *scope, pic_value form, pic_sym *self)
 {
   pic_value skel = pic_cons(pic, pic_invalid_value(), pic_invalid_value());
+  pic_value src;
+
+  src = pic_list3(pic, form, pic_int_value(scope->time++), self ? pic_obj_value(self) : pic_false_value());
 
-  pic_set_car(pic, scope->defer, pic_acons(pic, form, skel, pic_car(pic, scope->defer)));
+  pic_set_car(pic, scope->defer, pic_acons(pic, src, skel, pic_car(pic, scope->defer)));
 
   return skel;
 }
@@ -482,15 +624,30 @@ analyze_defer(pic_state *pic, analyze_scope *scope, pic_value form)
 static void
 analyze_deferred(pic_state *pic, analyze_scope *scope)
 {
-  pic_value defer, val, src, dst, it;
+  pic_value defer, val, src, dst, self, it;
+  pic_vec *frees;
+  pic_sym *sym;
+  khiter_t k;
+  int i, ret;
 
   scope->defer = pic_car(pic, scope->defer);
 
   pic_for_each (defer, pic_reverse(pic, scope->defer), it) {
     src = pic_car(pic, defer);
     dst = pic_cdr(pic, defer);
+    self = pic_list_ref(pic, src, 2);
 
-    val = analyze_lambda(pic, scope, src);
+    val = analyze_lambda(pic, scope, pic_car(pic, src), pic_false_p(self) ? NULL : pic_sym_ptr(self));
+
+    /* the closure copies whatever is not defined yet */
+    frees = pic_vec_ptr(pic_list_ref(pic, val, 5));
+    for (i = 0; i < frees->len; ++i) {
+      sym = pic_sym_ptr(frees->data[i]);
+      k = kh_get(d, &scope->defs, sym);
+      if (k != kh_end(&scope->defs) && kh_val(&scope->defs, k) > pic_int(pic_list_ref(pic, src, 1))) {
+        kh_put(a, &scope->sets, sym, &ret);
+      }
+    }
 
     /* copy */
     pic_set_car(pic, dst, pic_car(pic, val));
@@ -499,19 +656,21 @@ analyze_deferred(pic_state *pic, analyze_scope *scope)
 }
 
 static pic_value
-analyze_lambda(pic_state *pic, analyze_scope *up, pic_value form)
+analyze_lambda(pic_state *pic, analyze_scope *up, pic_value form, pic_sym *self)
 {
   analyze_scope s, *scope = &s;
   pic_value formals, body;
   pic_value rest = pic_undef_value();
-  pic_vec *args, *locals, *captures;
+  pic_vec *args, *locals, *boxes, *frees;
+  bool lifted, lazy;
   int i, j;
   khiter_t it;
 
   formals = pic_list_ref(pic, form, 1);
   body = pic_list_ref(pic, form, 2);
 
-  analyzer_scope_init(pic, scope, formals, up);
+  analyzer_scope_init(pic, scope, formals, self, up);
+  scan_body(pic, scope, body, NULL, false);
 
   /* analyze body */
   body = analyze(pic, scope, body);
@@ -525,6 +684,10 @@ analyze_lambda(pic_state *pic, analyze_scope *up, pic_value form)
   if (scope->rest != NULL) {
     rest = pic_obj_value(scope->rest);
   }
+  lazy = scope->rest != NULL
+    && kh_get(a, &scope->captures, scope->rest) == kh_end(&scope->captures)
+    && kh_get(a, &scope->sets, scope->rest) == kh_end(&scope->sets)
+    && kh_get(d, &scope->defs, scope->rest) == kh_end(&scope->defs);
 
   locals = pic_make_vec(pic, kh_size(&scope->locals));
   j = 0;
@@ -539,16 +702,30 @@ analyze_lambda(pic_state *pic, analyze_scope *up, pic_value form)
     }
   }
 
-  captures = pic_make_vec(pic, kh_size(&scope->captures));
+  for (it = kh_begin(&scope->captures); it < kh_end(&scope->captures); ++it) {
+    if (kh_exist(&scope->captures, it) && kh_get(a, &scope->sets, kh_key(&scope->captures, it)) == kh_end(&scope->sets)) {
+      kh_del(a, &scope->captures, it); /* never assigned, copy the value */
+    }
+  }
+  boxes = pic_make_vec(pic, kh_size(&scope->captures));
   for (it = kh_begin(&scope->captures), j = 0; it < kh_end(&scope->captures); ++it) {
     if (kh_exist(&scope->captures, it)) {
-      captures->data[j++] = pic_obj_value(kh_key(&scope->captures, it));
+      boxes->data[j++] = pic_obj_value(kh_key(&scope->captures, it));
+    }
+  }
+
+  frees = pic_make_vec(pic, kh_size(&scope->frees));
+  for (it = kh_begin(&scope->frees), j = 0; it < kh_end(&scope->frees); ++it) {
+    if (kh_exist(&scope->frees, it)) {
+      frees->data[j++] = pic_obj_value(kh_key(&scope->frees, it));
     }
   }
 
   analyzer_scope_destroy(pic, scope);
 
-  return pic_list6(pic, pic_obj_value(pic->uLAMBDA), rest, pic_obj_value(args), pic_obj_value(locals), pic_obj_value(captures), body);
+  lifted = self != NULL && pic_pair_p(pic_assq(pic, pic_obj_value(self), pic_car(pic, up->lifts)));
+
+  return pic_cons(pic, pic_obj_value(pic->uLAMBDA), pic_cons(pic, rest, pic_cons(pic, pic_obj_value(args), pic_list7(pic, pic_obj_value(locals), pic_obj_value(boxes), pic_obj_value(frees), self ? pic_obj_value(self) : pic_false_value(), pic_bool_value(lifted), pic_bool_value(lazy), body))));
 }
 
 static pic_value
@@ -563,17 +740,62 @@ analyze_list(pic_state *pic, analyze_scope *scope, pic_value obj)
   return pic_reverse(pic, seq);
 }
 
+static bool
+known_p(pic_state *pic, analyze_scope *scope, pic_sym *sym, pic_value form)
+{
+  pic_value formals = pic_list_ref(pic, form, 1);
+  khiter_t k;
+
+  if (kh_get(a, &scope->escapes, sym) != kh_end(&scope->escapes) || ! pic_list_p(formals)) {
+    return false;
+  }
+  k = kh_get(d, &scope->calls, sym);
+  return k == kh_end(&scope->calls) || kh_val(&scope->calls, k) == pic_length(pic, formals);
+}
+
 static pic_value
 analyze_define(pic_state *pic, analyze_scope *scope, pic_value obj)
 {
-  define_var(pic, scope, pic_sym_ptr(pic_list_ref(pic, obj, 1)));
+  pic_sym *sym = pic_sym_ptr(pic_list_ref(pic, obj, 1));
+  pic_value var, val;
+  bool known;
+  khiter_t k;
+
+  define_var(pic, scope, sym);
 
-  return pic_cons(pic, pic_car(pic, obj), analyze_list(pic, scope, pic_cdr(pic, obj)));
+  var = analyze(pic, scope, pic_obj_value(sym));
+  val = pic_list_ref(pic, obj, 2);
+  if (scope->depth > 0 && lambda_form_p(pic, val) && kh_get(a, &scope->sets, sym) == kh_end(&scope->sets)) {
+    known = known_p(pic, scope, sym, val);
+    val = analyze_defer(pic, scope, val, sym);
+    if (known) {
+      pic_set_car(pic, scope->lifts, pic_acons(pic, pic_obj_value(sym), val, pic_car(pic, scope->lifts)));
+    }
+  } else {
+    val = analyze(pic, scope, val);
+  }
+
+  if ((k = kh_get(d, &scope->defs, sym)) != kh_end(&scope->defs)) {
+    kh_val(&scope->defs, k) = scope->time++;
+  }
+  return pic_list3(pic, pic_car(pic, obj), var, val);
 }
 
 static pic_value
 analyze_call(pic_state *pic, analyze_scope *scope, pic_value obj)
 {
+  pic_value lift = pic_false_value();
+
+  /* a call of a lifted procedure passes its free variables along */
+  if (pic_sym_p(pic_car(pic, obj))) {
+    lift = pic_assq(pic, pic_car(pic, obj), pic_car(pic, scope->lifts));
+    if (pic_false_p(lift) && scope->self == pic_sym_ptr(pic_car(pic, obj))) {
+      lift = pic_assq(pic, pic_car(pic, obj), pic_car(pic, scope->up->lifts));
+    }
+  }
+  if (pic_pair_p(lift)) {
+    return pic_cons(pic, pic_obj_value(LCALL), pic_cons(pic, pic_cdr(pic, lift), analyze_list(pic, scope, obj)));
+  }
   return pic_cons(pic, pic_obj_value(CALL), analyze_list(pic, scope, obj));
 }
 
@@ -599,7 +821,7 @@ analyze_node(pic_state *pic, analyze_scope *scope, pic_value obj)
         return analyze_define(pic, scope, obj);
       }
       else if (sym == pic->uLAMBDA) {
-        return analyze_defer(pic, scope, obj);
+        return analyze_defer(pic, scope, obj, NULL);
       }
       else if (sym == pic->uQUOTE) {
         return obj;
@@ -634,7 +856,7 @@ pic_analyze(pic_state *pic, pic_value obj)
 {
   analyze_scope s, *scope = &s;
 
-  analyzer_scope_init(pic, scope, pic_nil_value(), NULL);
+  analyzer_scope_init(pic, scope, pic_nil_value(), NULL, NULL);
 
   obj = analyze(pic, scope, obj);
 
@@ -647,7 +869,13 @@ pic_analyze(pic_state *pic, pic_value obj)
 typedef struct codegen_context {
   /* rest args variable is counted as a local */
   pic_sym *rest;
-  pic_vec *args, *locals, *captures;
+  /* the rest list is made on demand, see codegen_rest */
+  bool lazyrest;
+  pic_vec *args, *locals;
+  /* the variable referring to the closure itself, see analyze_define */
+  pic_sym *self;
+  /* boxed variables and free variables, see analyze_lambda */
+  pic_vec *boxes, *frees;
   /* actual bit code sequence */
   pic_code *code;
   size_t clen, ccapa;
@@ -657,6 +885,8 @@ typedef struct codegen_context {
   /* constant object pool */
   pic_value *pool;
   size_t plen, pcapa;
+  /* number of call sites */
+  size_t cachelen;
 
   struct codegen_context *up;
 } codegen_context;
@@ -664,14 +894,17 @@ typedef struct codegen_context {
 static void create_activation(pic_state *, codegen_context *);
 
 static void
-codegen_context_init(pic_state *pic, codegen_context *cxt, codegen_context *up, pic_sym *rest, pic_vec *args, pic_vec *locals, pic_vec *captures)
+codegen_context_init(pic_state *pic, codegen_context *cxt, codegen_context *up, pic_sym *rest, pic_sym *self, pic_vec *args, pic_vec *locals, pic_vec *boxes, pic_vec *frees)
 {
   cxt->up = up;
   cxt->rest = rest;
+  cxt->lazyrest = false;
+  cxt->self = self;
 
   cxt->args = args;
   cxt->locals = locals;
-  cxt->captures = captures;
+  cxt->boxes = boxes;
+  cxt->frees = frees;
 
   cxt->code = pic_calloc(pic, PIC_ISEQ_SIZE, sizeof(pic_code));
   cxt->clen = 0;
@@ -685,25 +918,98 @@ codegen_context_init(pic_state *pic, codegen_context *cxt, codegen_context *up,
   cxt->plen = 0;
   cxt->pcapa = PIC_POOL_SIZE;
 
+  cxt->cachelen = 0;
+
   create_activation(pic, cxt);
 }
 
+/**
+ * Fuse frequent sequences into superinstructions. A call to an inlined
+ * primitive compiles to an OP_GREF of the primitive followed by its
+ * operands and opcode; the superinstruction overwrites the OP_GREF and
+ * leaves the rest of the sequence in place, so jump offsets and targets
+ * are unaffected and the VM can fall back to it when the primitive has
+ * been redefined.
+ */
+static void
+codegen_peephole(pic_state *pic, codegen_context *cxt)
+{
+  pic_code *code = cxt->code;
+  struct pic_box *box;
+  size_t i;
+
+  for (i = 0; i + 2 < cxt->clen; ++i) {
+    if (code[i].insn == OP_GREF && code[i + 1].insn == OP_LREFREST && code[i + 2].u.i == 2) {
+      box = pic_box_ptr(cxt->pool[code[i].u.i]);
+
+      if (box == pic->cNILP && code[i + 2].insn == OP_NILP) {
+        code[i].insn = OP_RESTNILP;
+      }
+      else if (box == pic->cPAIRP && code[i + 2].insn == OP_PAIRP) {
+        code[i].insn = OP_RESTPAIRP;
+      }
+      else if (box == pic->cCAR && code[i + 2].insn == OP_CAR) {
+        code[i].insn = OP_RESTCAR;
+      }
+      continue;
+    }
+    if (code[i].insn != OP_GREF || code[i + 1].insn != OP_LREF) {
+      continue;
+    }
+    box = pic_box_ptr(cxt->pool[code[i].u.i]);
+
+    if (box == pic->cCAR && code[i + 2].insn == OP_CAR && code[i + 2].u.i == 2) {
+      code[i].insn = OP_LREFCAR;
+    }
+    else if (box == pic->cCDR && code[i + 2].insn == OP_CDR && code[i + 2].u.i == 2) {
+      code[i].insn = OP_LREFCDR;
+    }
+    else if (box == pic->cNILP && code[i + 2].insn == OP_NILP && code[i + 2].u.i == 2) {
+      if (i + 3 < cxt->clen && code[i + 3].insn == OP_JMPIF) {
+        code[i].insn = OP_LREFNILPJMPIF;
+      }
+    }
+    else if (i + 3 < cxt->clen && code[i + 2].insn == OP_PUSHINT) {
+      if (box == pic->cADD && code[i + 3].insn == OP_ADD && code[i + 3].u.i == 3) {
+        code[i].insn = OP_LREFADDI;
+      }
+      else if (box == pic->cSUB && code[i + 3].insn == OP_SUB && code[i + 3].u.i == 3) {
+        code[i].insn = OP_LREFSUBI;
+      }
+    }
+  }
+}
+
 static struct pic_irep *
 codegen_context_destroy(pic_state *pic, codegen_context *cxt)
 {
   struct pic_irep *irep;
 
+  codegen_peephole(pic, cxt);
+
   /* create irep */
   irep = (struct pic_irep *)pic_obj_alloc(pic, sizeof(struct pic_irep), PIC_TT_IREP);
   irep->varg = cxt->rest != NULL;
+  irep->lazyrest = cxt->lazyrest;
   irep->argc = (int)cxt->args->len + 1;
   irep->localc = (int)cxt->locals->len;
-  irep->capturec = (int)cxt->captures->len;
+  irep->freec = (int)cxt->frees->len;
+  irep->stackc = (int)(cxt->locals->len + cxt->clen); /* no instruction pushes more than one */
   irep->code = pic_realloc(pic, cxt->code, sizeof(pic_code) * cxt->clen);
+  irep->clen = cxt->clen;
   irep->irep = pic_realloc(pic, cxt->irep, sizeof(struct pic_irep *) * cxt->ilen);
   irep->ilen = cxt->ilen;
   irep->pool = pic_realloc(pic, cxt->pool, sizeof(pic_value) * cxt->plen);
   irep->plen = cxt->plen;
+  irep->cache = cxt->cachelen ? pic_calloc(pic, cxt->cachelen, sizeof(struct pic_irep *)) : NULL;
+  irep->cachelen = cxt->cachelen;
+#if PIC_JIT
+  irep->calls = 0;
+  irep->jit = NULL;
+#endif
+#if VM_PROFILE
+  irep->prof = NULL;
+#endif
 
   return irep;
 }
@@ -739,18 +1045,38 @@ codegen_context_destroy(pic_state *pic, codegen_context *cxt)
     cxt->clen++;                                \
   } while (0)                                   \
 
-#define emit_r(pic, cxt, ins, D, I) do {        \
+#define emit_call(pic, cxt, ins, N) do {        \
     check_code_size(pic, cxt);                  \
     cxt->code[cxt->clen].insn = ins;            \
-    cxt->code[cxt->clen].u.r.depth = D;         \
-    cxt->code[cxt->clen].u.r.idx = I;           \
+    cxt->code[cxt->clen].u.call.argc = N;       \
+    cxt->code[cxt->clen].u.call.site = (int)cxt->cachelen++;   \
+    cxt->clen++;                                \
+  } while (0)                                   \
+
+#define emit_o(pic, cxt, ins, A, B) do {        \
+    check_code_size(pic, cxt);                  \
+    cxt->code[cxt->clen].insn = ins;            \
+    cxt->code[cxt->clen].u.o.a = A;             \
+    cxt->code[cxt->clen].u.o.b = B;             \
     cxt->clen++;                                \
   } while (0)                                   \
 
 #define emit_ret(pic, cxt, tailpos) if (tailpos) emit_n(pic, cxt, OP_RET)
 
 static int
-index_capture(codegen_context *cxt, pic_sym *sym, int depth)
+index_free(codegen_context *cxt, pic_sym *sym)
+{
+  int i;
+
+  for (i = 0; i < cxt->frees->len; ++i) {
+    if (pic_sym_ptr(cxt->frees->data[i]) == sym)
+      return i;
+  }
+  return -1;
+}
+
+static bool
+boxed_p(codegen_context *cxt, pic_sym *sym, int depth)
 {
   int i;
 
@@ -758,11 +1084,11 @@ index_capture(codegen_context *cxt, pic_sym *sym, int depth)
     cxt = cxt->up;
   }
 
-  for (i = 0; i < cxt->captures->len; ++i) {
-    if (pic_sym_ptr(cxt->captures->data[i]) == sym)
-      return i;
+  for (i = 0; i < cxt->boxes->len; ++i) {
+    if (pic_sym_ptr(cxt->boxes->data[i]) == sym)
+      return true;
   }
-  return -1;
+  return false;
 }
 
 static int
@@ -780,6 +1106,9 @@ index_local(codegen_context *cxt, pic_sym *sym)
     if (pic_sym_ptr(cxt->locals->data[i]) == sym)
       return i + offset;
   }
+  if (cxt->self == sym) {
+    return 0;
+  }
   return -1;
 }
 
@@ -804,21 +1133,30 @@ create_activation(pic_state *pic, codegen_context *cxt)
 {
   int i, n;
 
-  for (i = 0; i < cxt->captures->len; ++i) {
-    n = index_local(cxt, pic_sym_ptr(cxt->captures->data[i]));
+  for (i = 0; i < cxt->boxes->len; ++i) {
+    n = index_local(cxt, pic_sym_ptr(cxt->boxes->data[i]));
     assert(n != -1);
-    if (n <= cxt->args->len || cxt->rest == pic_sym_ptr(cxt->captures->data[i])) {
-      /* copy arguments to capture variable area */
-      emit_i(pic, cxt, OP_LREF, n);
-    } else {
-      /* otherwise, just extend the stack */
-      emit_n(pic, cxt, OP_PUSHUNDEF);
-    }
+    emit_i(pic, cxt, OP_BOX, n);
   }
 }
 
 static void codegen(pic_state *, codegen_context *, pic_value, bool);
 
+static void
+codegen_free(pic_state *pic, codegen_context *cxt, pic_sym *sym)
+{
+  int n;
+
+  /* lifted procedures take their free variables as arguments */
+  if ((n = index_local(cxt, sym)) != -1) {
+    emit_i(pic, cxt, OP_LREF, n);
+  } else {
+    n = index_free(cxt, sym);
+    assert(n != -1);
+    emit_i(pic, cxt, OP_CREF, n);
+  }
+}
+
 static void
 codegen_ref(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
 {
@@ -838,21 +1176,26 @@ codegen_ref(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
 
     depth = pic_int(pic_list_ref(pic, obj, 1));
     name  = pic_sym_ptr(pic_list_ref(pic, obj, 2));
-    emit_r(pic, cxt, OP_CREF, depth, index_capture(cxt, name, depth));
+    codegen_free(pic, cxt, name);
+    if (boxed_p(cxt, name, depth)) {
+      emit_n(pic, cxt, OP_UNBOX);
+    }
     emit_ret(pic, cxt, tailpos);
   }
   else if (sym == LREF) {
     pic_sym *name;
-    int i;
 
     name = pic_sym_ptr(pic_list_ref(pic, obj, 1));
-    if ((i = index_capture(cxt, name, 0)) != -1) {
-      emit_i(pic, cxt, OP_LREF, i + (int)cxt->args->len + (int)cxt->locals->len + 1);
-      emit_ret(pic, cxt, tailpos);
-    } else {
-      emit_i(pic, cxt, OP_LREF, index_local(cxt, name));
+    if (cxt->lazyrest && name == cxt->rest) {
+      emit_i(pic, cxt, OP_LREFREST, index_local(cxt, name));
       emit_ret(pic, cxt, tailpos);
+      return;
+    }
+    emit_i(pic, cxt, OP_LREF, index_local(cxt, name));
+    if (boxed_p(cxt, name, 0)) {
+      emit_n(pic, cxt, OP_UNBOX);
     }
+    emit_ret(pic, cxt, tailpos);
   }
 }
 
@@ -876,25 +1219,24 @@ codegen_set(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
   }
   else if (type == CREF) {
     pic_sym *name;
-    int depth;
 
-    depth = pic_int(pic_list_ref(pic, var, 1));
-    name  = pic_sym_ptr(pic_list_ref(pic, var, 2));
-    emit_r(pic, cxt, OP_CSET, depth, index_capture(cxt, name, depth));
+    /* assigned, hence boxed */
+    name = pic_sym_ptr(pic_list_ref(pic, var, 2));
+    codegen_free(pic, cxt, name);
+    emit_n(pic, cxt, OP_SETBOX);
     emit_ret(pic, cxt, tailpos);
   }
   else if (type == LREF) {
     pic_sym *name;
-    int i;
 
     name = pic_sym_ptr(pic_list_ref(pic, var, 1));
-    if ((i = index_capture(cxt, name, 0)) != -1) {
-      emit_i(pic, cxt, OP_LSET, i + (int)cxt->args->len + (int)cxt->locals->len + 1);
-      emit_ret(pic, cxt, tailpos);
+    if (boxed_p(cxt, name, 0)) {
+      emit_i(pic, cxt, OP_LREF, index_local(cxt, name));
+      emit_n(pic, cxt, OP_SETBOX);
     } else {
       emit_i(pic, cxt, OP_LSET, index_local(cxt, name));
-      emit_ret(pic, cxt, tailpos);
     }
+    emit_ret(pic, cxt, tailpos);
   }
 }
 
@@ -902,9 +1244,12 @@ static void
 codegen_lambda(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
 {
   codegen_context c, *inner_cxt = &c;
-  pic_value rest_opt, body;
-  pic_sym *rest = NULL;
-  pic_vec *args, *locals, *captures;
+  pic_value rest_opt, self_opt, body;
+  pic_sym *rest = NULL, *self = NULL;
+  pic_vec *args, *locals, *boxes, *frees;
+  struct pic_irep *irep;
+  bool lifted, lazy;
+  int i, pidx;
 
   check_irep_size(pic, cxt);
 
@@ -915,13 +1260,50 @@ codegen_lambda(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos
   }
   args = pic_vec_ptr(pic_list_ref(pic, obj, 2));
   locals = pic_vec_ptr(pic_list_ref(pic, obj, 3));
-  captures = pic_vec_ptr(pic_list_ref(pic, obj, 4));
-  body = pic_list_ref(pic, obj, 5);
+  boxes = pic_vec_ptr(pic_list_ref(pic, obj, 4));
+  frees = pic_vec_ptr(pic_list_ref(pic, obj, 5));
+  self_opt = pic_list_ref(pic, obj, 6);
+  if (pic_sym_p(self_opt)) {
+    self = pic_sym_ptr(self_opt);
+  }
+  lifted = pic_true_p(pic_list_ref(pic, obj, 7));
+  lazy = pic_true_p(pic_list_ref(pic, obj, 8));
+  body = pic_list_ref(pic, obj, 9);
+
+  if (lifted) {
+    pic_vec *v = pic_make_vec(pic, args->len + frees->len);
+
+    /* free variables follow the arguments */
+    for (i = 0; i < args->len; ++i) {
+      v->data[i] = args->data[i];
+    }
+    for (i = 0; i < frees->len; ++i) {
+      v->data[args->len + i] = frees->data[i];
+    }
+    args = v;
+    frees = pic_make_vec(pic, 0);
+  }
 
   /* emit irep */
-  codegen_context_init(pic, inner_cxt, cxt, rest, args, locals, captures);
+  codegen_context_init(pic, inner_cxt, cxt, rest, self, args, locals, boxes, frees);
+  inner_cxt->lazyrest = lazy;
   codegen(pic, inner_cxt, body, true);
-  cxt->irep[cxt->ilen] = codegen_context_destroy(pic, inner_cxt);
+  irep = cxt->irep[cxt->ilen] = codegen_context_destroy(pic, inner_cxt);
+
+  if (lifted) {
+    check_pool_size(pic, cxt);
+    pidx = (int)cxt->plen++;
+    cxt->pool[pidx] = pic_obj_value(pic_make_proc_irep(pic, irep, NULL));
+    emit_i(pic, cxt, OP_PUSHCONST, pidx);
+    emit_ret(pic, cxt, tailpos);
+    cxt->ilen++;
+    return;
+  }
+
+  /* push the free variables, boxes as they are */
+  for (i = 0; i < frees->len; ++i) {
+    codegen_free(pic, cxt, pic_sym_ptr(frees->data[i]));
+  }
 
   /* emit OP_LAMBDA */
   emit_i(pic, cxt, OP_LAMBDA, cxt->ilen++);
@@ -994,6 +1376,142 @@ codegen_quote(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
   }
 }
 
+#if PIC_REGISTER_VM
+
+/**
+ * Register instructions take their operands straight from frame slots
+ * and the constant pool instead of the stack: an operand x >= 0 is the
+ * slot OP_LREF x would push, and x < 0 is the pool entry -x - 1. Only
+ * the result is pushed.
+ */
+
+static bool
+register_operand_p(pic_state *pic, codegen_context *cxt, pic_value obj)
+{
+  pic_sym *sym;
+
+  sym = pic_sym_ptr(pic_car(pic, obj));
+  if (sym == LREF) {
+    pic_sym *name = pic_sym_ptr(pic_list_ref(pic, obj, 1));
+
+    return ! boxed_p(cxt, name, 0) && ! (cxt->lazyrest && name == cxt->rest);
+  }
+  return sym == pic->uQUOTE;
+}
+
+static int
+register_operand(pic_state *pic, codegen_context *cxt, pic_value obj)
+{
+  pic_sym *sym, *name;
+  int i;
+
+  sym = pic_sym_ptr(pic_car(pic, obj));
+  if (sym == LREF) {
+    name = pic_sym_ptr(pic_list_ref(pic, obj, 1));
+    return index_local(cxt, name);
+  }
+  else {
+    check_pool_size(pic, cxt);
+    i = (int)cxt->plen++;
+    cxt->pool[i] = pic_list_ref(pic, obj, 1);
+    return -i - 1;
+  }
+}
+
+static bool
+codegen_register_call(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
+{
+  pic_value functor, args, elt, it;
+  pic_sym *sym;
+  int argc, insn = -1, a, b = 0;
+
+  functor = pic_list_ref(pic, obj, 1);
+  if (pic_sym_ptr(pic_list_ref(pic, functor, 0)) != GREF) {
+    return false;
+  }
+  sym = pic_sym_ptr(pic_list_ref(pic, functor, 1));
+  args = pic_list_tail(pic, obj, 2);
+  argc = pic_length(pic, args);
+
+  if (argc == 1) {
+    if (sym == pic->uCAR) insn = OP_RCAR;
+    else if (sym == pic->uCDR) insn = OP_RCDR;
+    else if (sym == pic->uNILP) insn = OP_RNILP;
+    else if (sym == pic->uSYMBOLP) insn = OP_RSYMBOLP;
+    else if (sym == pic->uPAIRP) insn = OP_RPAIRP;
+    else if (sym == pic->uNOT) insn = OP_RNOT;
+  }
+  else if (argc == 2) {
+    if (sym == pic->uCONS) insn = OP_RCONS;
+    else if (sym == pic->uADD) insn = OP_RADD;
+    else if (sym == pic->uSUB) insn = OP_RSUB;
+    else if (sym == pic->uMUL) insn = OP_RMUL;
+    else if (sym == pic->uDIV) insn = OP_RDIV;
+    else if (sym == pic->uEQ) insn = OP_REQ;
+    else if (sym == pic->uLT) insn = OP_RLT;
+    else if (sym == pic->uLE) insn = OP_RLE;
+    else if (sym == pic->uGT) insn = OP_RGT;
+    else if (sym == pic->uGE) insn = OP_RGE;
+  }
+  if (insn == -1) {
+    return false;
+  }
+
+  pic_for_each (elt, args, it) {
+    if (! register_operand_p(pic, cxt, elt)) {
+      return false;
+    }
+  }
+
+  a = register_operand(pic, cxt, pic_car(pic, args));
+  if (argc == 2) {
+    b = register_operand(pic, cxt, pic_cadr(pic, args));
+  }
+  emit_o(pic, cxt, insn, a, b);
+  emit_ret(pic, cxt, tailpos);
+  return true;
+}
+
+#endif
+
+/**
+ * A rest list that is only tested, taken apart or handed on to apply never
+ * needs to exist. The callee leaves the extra arguments on its stack, above
+ * the locals, and keeps their count in the slot of the rest variable;
+ * OP_RESTNILP, OP_RESTPAIRP and OP_RESTCAR answer from the stack and
+ * OP_APPLYREST pushes the extra arguments again instead of spreading a
+ * list. Any other reference, OP_LREFREST, conses the list once in place.
+ */
+static bool
+codegen_rest(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
+{
+  int len = (int)pic_length(pic, obj);
+  pic_value functor, last, elt, it;
+  int i;
+
+  if (! cxt->lazyrest || len < 4) {
+    return false;
+  }
+  functor = pic_list_ref(pic, obj, 1);
+  if (pic_sym_ptr(pic_list_ref(pic, functor, 0)) != GREF || pic_sym_ptr(pic_list_ref(pic, functor, 1)) != pic->uAPPLY) {
+    return false;
+  }
+  last = pic_list_ref(pic, obj, len - 1);
+  if (pic_sym_ptr(pic_list_ref(pic, last, 0)) != LREF || pic_sym_ptr(pic_list_ref(pic, last, 1)) != cxt->rest) {
+    return false;
+  }
+
+  i = 0;
+  pic_for_each (elt, pic_cdr(pic, obj), it) {
+    if (++i == len - 1) {
+      break;
+    }
+    codegen(pic, cxt, elt, false);
+  }
+  emit_o(pic, cxt, OP_APPLYREST, len - 2, tailpos);
+  return true;
+}
+
 #define VM(uid, op)                             \
     if (sym == uid) {                           \
       emit_i(pic, cxt, op, len - 1);            \
@@ -1007,6 +1525,15 @@ codegen_call(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
   int len = (int)pic_length(pic, obj);
   pic_value elt, it, functor;
 
+#if PIC_REGISTER_VM
+  if (codegen_register_call(pic, cxt, obj, tailpos)) {
+    return;
+  }
+#endif
+  if (codegen_rest(pic, cxt, obj, tailpos)) {
+    return;
+  }
+
   pic_for_each (elt, pic_cdr(pic, obj), it) {
     codegen(pic, cxt, elt, false);
   }
@@ -1035,7 +1562,41 @@ codegen_call(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
     VM(pic->uDIV, OP_DIV)
   }
 
-  emit_i(pic, cxt, (tailpos ? OP_TAILCALL : OP_CALL), len - 1);
+  emit_call(pic, cxt, (tailpos ? OP_TAILCALL : OP_CALL), len - 1);
+}
+
+static void
+codegen_lcall(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
+{
+  pic_value functor, elt, it;
+  pic_vec *frees;
+  int i, len = (int)pic_length(pic, obj);
+
+  /* a loop: rebind the arguments and start over, the free variables stay */
+  functor = pic_list_ref(pic, obj, 2);
+  if (tailpos && pic_sym_ptr(pic_car(pic, functor)) == LREF && pic_sym_ptr(pic_list_ref(pic, functor, 1)) == cxt->self) {
+    pic_for_each (elt, pic_list_tail(pic, obj, 3), it) {
+      codegen(pic, cxt, elt, false);
+    }
+    for (i = len - 3; i > 0; --i) {
+      emit_i(pic, cxt, OP_LSET, i);
+      emit_n(pic, cxt, OP_POP);
+    }
+    emit_i(pic, cxt, OP_JMP, -(int)cxt->clen);
+    return;
+  }
+
+  pic_for_each (elt, pic_cddr(pic, obj), it) {
+    codegen(pic, cxt, elt, false);
+  }
+
+  /* the free variables of the lifted procedure, boxes as they are */
+  frees = pic_vec_ptr(pic_list_ref(pic, pic_list_ref(pic, obj, 1), 5));
+  for (i = 0; i < frees->len; ++i) {
+    codegen_free(pic, cxt, pic_sym_ptr(frees->data[i]));
+  }
+
+  emit_call(pic, cxt, (tailpos ? OP_TAILCALL : OP_CALL), len - 2 + frees->len);
 }
 
 static void
@@ -1065,6 +1626,9 @@ codegen(pic_state *pic, codegen_context *cxt, pic_value obj, bool tailpos)
   else if (sym == CALL) {
     codegen_call(pic, cxt, obj, tailpos);
   }
+  else if (sym == LCALL) {
+    codegen_lcall(pic, cxt, obj, tailpos);
+  }
   else {
     pic_errorf(pic, "codegen: unknown AST type ~s", obj);
   }
@@ -1076,7 +1640,7 @@ pic_codegen(pic_state *pic, pic_value obj)
   pic_vec *empty = pic_make_vec(pic, 0);
   codegen_context c, *cxt = &c;
 
-  codegen_context_init(pic, cxt, NULL, NULL, empty, empty, empty);
+  codegen_context_init(pic, cxt, NULL, NULL, NULL, empty, empty, empty, empty);
 
   codegen(pic, cxt, obj, true);
 
@@ -71,6 +71,10 @@ pic_load_point(pic_state *pic, struct pic_cont *cont)
 {
   pic_wind(pic, pic->cp, cont->cp);
 
+#if VM_PROFILE
+  pic_vm_prof_unwind(pic, pic->cibase + cont->ci_offset);
+#endif
+
   /* load runtime context */
   pic->cp = cont->cp;
   pic->sp = pic->stbase + cont->sp_offset;
@@ -80,6 +84,8 @@ pic_load_point(pic_state *pic, struct pic_cont *cont)
   pic->ip = cont->ip;
   pic->ptable = cont->ptable;
   pic->cc = cont->prev;
+
+  pic_vm_reclaim_headroom(pic);
 }
 
 static pic_value
@@ -213,6 +219,10 @@ pic_values(pic_state *pic, int argc, pic_value *argv)
 {
   int i;
 
+  if (pic->sp + argc >= pic->stend) {
+    pic_vm_grow_stack(pic, argc, &argv);
+  }
+
   for (i = 0; i < argc; ++i) {
     pic->sp[i] = argv[i];
   }
@@ -227,6 +237,11 @@ pic_values_by_list(pic_state *pic, pic_value list)
   pic_value v, it;
   int i;
 
+  i = pic_length(pic, list);
+  if (pic->sp + i >= pic->stend) {
+    pic_vm_grow_stack(pic, i, NULL);
+  }
+
   i = 0;
   pic_for_each (v, list, it) {
     pic->sp[i++] = v;
@@ -4,18 +4,27 @@
 
 #include "picrin.h"
 
+/** only the innermost frames of a deep stack are listed */
+#define BACKTRACE_DEPTH 64
+
 pic_str *
 pic_get_backtrace(pic_state *pic)
 {
   size_t ai = pic_gc_arena_preserve(pic);
   pic_callinfo *ci;
   pic_str *trace;
+  int depth = 0;
 
   trace = pic_make_str(pic, NULL, 0);
 
   for (ci = pic->ci; ci != pic->cibase; --ci) {
     struct pic_proc *proc = pic_proc_ptr(ci->fp[0]);
 
+    if (depth++ == BACKTRACE_DEPTH) {
+      trace = pic_str_cat(pic, trace, pic_make_str_cstr(pic, "  ...\n"));
+      break;
+    }
+
     trace = pic_str_cat(pic, trace, pic_make_str_cstr(pic, "  at "));
     trace = pic_str_cat(pic, trace, pic_make_str_cstr(pic, "(anonymous lambda)"));
 
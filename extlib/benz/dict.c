@@ -31,13 +31,15 @@ pic_dict_ref(pic_state *pic, struct pic_dict *dict, pic_sym *key)
 }
 
 void
-pic_dict_set(pic_state PIC_UNUSED(*pic), struct pic_dict *dict, pic_sym *key, pic_value val)
+pic_dict_set(pic_state *pic, struct pic_dict *dict, pic_sym *key, pic_value val)
 {
   khash_t(dict) *h = &dict->hash;
   int ret;
   khiter_t it;
 
   it = kh_put(dict, h, key, &ret);
+  pic_write_barrier(pic, dict, pic_obj_value(key));
+  pic_write_barrier(pic, dict, val);
   kh_val(h, it) = val;
 }
 
@@ -95,13 +95,14 @@ struct pic_error *
 pic_make_error(pic_state *pic, pic_sym *type, const char *msg, pic_value irrs)
 {
   struct pic_error *e;
-  pic_str *stack;
+  pic_str *stack, *str;
 
   stack = pic_get_backtrace(pic);
+  str = pic_make_str_cstr(pic, msg);
 
   e = (struct pic_error *)pic_obj_alloc(pic, sizeof(struct pic_error), PIC_TT_ERROR);
   e->type = type;
-  e->msg = pic_make_str_cstr(pic, msg);
+  e->msg = str;
   e->irrs = irrs;
   e->stack = stack;
 
@@ -4,18 +4,64 @@
 
 #include "picrin.h"
 
-union header {
+#if PIC_USE_MMAP
+# include <sys/mman.h>
+#endif
+
+#if PIC_ENABLE_LIBC
+# include <time.h>
+# define GC_CLOCK() ((unsigned long)(clock() * (1000000.0 / CLOCKS_PER_SEC)))
+#else
+# define GC_CLOCK() 0UL
+#endif
+
+/**
+ * Objects larger than PIC_HEAP_CLASS_MAX live in the large object space: each
+ * one is allocated on its own behind this header and chained for the sweeper.
+ */
+
+struct large_object {
+  struct large_object *next;
+  size_t size;                  /* bytes allocated, header included */
+};
+
+/**
+ * Small objects are allocated from segregated size classes. Each class owns a
+ * chain of pages carved into equally sized slots. A free slot is recognized by
+ * its type tag (PIC_TT_INVALID never appears on a live heap object) and reuses
+ * its body as the link of the class free list.
+ */
+
+union slot {
+  struct pic_basic basic;
   struct {
-    union header *ptr;
-    size_t size;
-  } s;
+    PIC_OBJECT_HEADER
+    union slot *next;
+  } free;
+};
+
+struct class_page {
+  char *basep, *topp, *endp;    /* slots in [basep, topp) have been handed out */
+  struct class_page *next;
+};
+
+struct size_class {
+  size_t size;                  /* slot size */
+  union slot *freep;
+  struct class_page *pages;
+  struct class_page **sweep;    /* link to the first page not swept yet */
 };
 
-struct heap_page {
-  union header *basep, *endp;
-  struct heap_page *next;
+struct compact_page {
+  struct class_page *page;
+  struct size_class *cls;
+  bool pinned;
 };
 
+#define CLASS_UNIT sizeof(struct large_object)
+#define CLASS_COUNT ((PIC_HEAP_CLASS_MAX + CLASS_UNIT - 1) / CLASS_UNIT)
+#define CLASS_INDEX(size) (((size) - 1) / CLASS_UNIT)
+
 struct pic_object {
   union {
     struct pic_basic basic;
@@ -31,7 +77,6 @@ struct pic_object {
     struct pic_id id;
     struct pic_env env;
     struct pic_proc proc;
-    struct pic_context cxt;
     struct pic_irep irep;
     struct pic_port port;
     struct pic_error err;
@@ -41,41 +86,340 @@ struct pic_object {
   } u;
 };
 
+/**
+ * The collector is generational with sticky mark bits. An object that
+ * survives a collection keeps its mark and is regarded as old; freshly
+ * allocated objects are unmarked (young). A minor collection traces only
+ * from the roots and the remembered set, stopping at old objects, and sweeps
+ * unmarked objects without clearing the marks of the survivors. A major
+ * collection flips the meaning of the mark (`black' alternates between two
+ * values), which turns every object white at once without touching it.
+ *
+ * Stores that may create old-to-young references must go through
+ * pic_write_barrier. It whitens the old object and puts it into the
+ * remembered set, so that the next collection traces it again. Data objects
+ * with a custom mark function cannot be guarded by the barrier and are
+ * traced by every minor collection instead.
+ *
+ * Marking uses an explicit gray stack. A major collection requested by a
+ * minor one runs incrementally: its work is interleaved with allocation in
+ * steps of PIC_GC_STEP_BUDGET, and the same barrier keeps black objects from
+ * pointing to white ones in the meantime. Roots, the remembered set and data
+ * objects are traced once more in the final atomic step, before sweeping.
+ *
+ * Class pages are swept lazily, a page at a time, when a size class runs out
+ * of free slots. Whatever is left is swept before the next collection starts,
+ * which is also when the heap growth policy sees the number of live bytes.
+ * A page without survivors moves to a common empty list, from which any size
+ * class may take it again; empty pages are returned to the system when the
+ * heap is well above the target size given by PIC_HEAP_TARGET.
+ *
+ * Large objects and the buffers owned by heap objects are not part of that
+ * size. They are accounted separately, and allocating them in excess of the
+ * same target ratio starts a collection on their own.
+ */
+
+#if PIC_GC_THREADS > 0
+
+#include <pthread.h>
+
+/**
+ * Parallel marking. Each thread traces from a private gray stack and hands
+ * a grain of it over to a shared stack whenever another thread is starving.
+ * Mark bits are claimed with a compare-and-swap, and the few shared
+ * structures touched while scanning (the shady list and the registry chain)
+ * are updated under the pool lock. The mutator thread takes part as worker 0.
+ */
+
+#define GC_GRAIN 64
+
+struct gc_worker {
+  struct gc_pool *pool;
+  pthread_t thread;
+  kvec_t(struct pic_object *) gray;
+};
+
+struct gc_pool {
+  pic_state *pic;
+  pthread_mutex_t lock;
+  pthread_cond_t start, work, done;
+  kvec_t(struct pic_object *) shared;
+  unsigned long epoch;          /* bumped to wake the helpers up */
+  int idle;                     /* workers waiting for something to trace */
+  int running;                  /* helpers that have not finished yet */
+  bool quit;
+  struct gc_worker workers[PIC_GC_THREADS + 1];
+};
+
+static __thread struct gc_worker *gc_self;
+
+static struct gc_pool *gc_pool_open(pic_state *);
+static void gc_pool_close(pic_state *, struct gc_pool *);
+
+#endif
+
+/**
+ * Registry entries are ephemerons: the value is kept alive only by its key.
+ * Once everything else is marked, the entries whose key is still white are
+ * queued up under their key, and marked when the key itself is reached.
+ */
+
+struct ephemeron {
+  pic_value val;
+  size_t next;                  /* index of the next entry with the same key */
+};
+
+#define EPHEMERON_NONE ((size_t)-1)
+
+KHASH_DECLARE(eph, void *, size_t)
+KHASH_DEFINE(eph, void *, size_t, kh_ptr_hash_func, kh_ptr_hash_equal)
+
+/* the destructor of a dead data object, run once the collector is done */
+struct finalizer {
+  void (*dtor)(pic_state *, void *);
+  void *data;
+};
+
+/**
+ * A guardian is handed back the objects registered to it once they are found
+ * unreachable, instead of letting them be reclaimed. The registered objects
+ * are not traced; the ones ready to be handed back are.
+ */
+struct guardian {
+  struct pic_data *owner;
+  kvec_t(struct pic_object *) objects;
+  kvec_t(struct pic_object *) ready;
+  struct guardian *next;
+};
+
 struct pic_heap {
-  union header base, *freep;
-  struct heap_page *pages;
+  struct large_object *large;
+  struct large_object *spare;   /* freed large blocks, see large_map */
+  struct size_class classes[CLASS_COUNT];
+  size_t size, limit;           /* total bytes of class pages and its upper bound */
+  struct class_page *empty;     /* free pages not owned by any size class */
+  size_t nempty;
+  bool major;                   /* next collection must be a major one */
+  size_t old_limit;             /* live bytes that trigger a major collection */
+  size_t allocated;             /* bytes allocated since the last major collection */
+  bool marking;                 /* an incremental major collection is in progress */
+  bool sweeping;                /* class pages are being swept lazily */
+  bool sweep_major;             /* the pending sweep follows a major collection */
+  size_t sweep_live;            /* live bytes found by the pending sweep so far */
+  size_t external;              /* bytes held by large objects and object buffers */
+  size_t external_debt;         /* of which allocated since the last collection */
+  size_t external_limit;        /* debt that triggers a collection */
+  size_t debt;                  /* allocations since the last incremental step */
+  kvec_t(struct pic_object *) gray;
+  kvec_t(struct pic_object *) remembered;
+  kvec_t(struct pic_object *) shady; /* old data objects with a mark function */
   struct pic_reg *regs;         /* weak map chain */
+  bool weak;                    /* registries are being traced */
+  khash_t(eph) waiting;         /* white key to the first entry waiting for it */
+  kvec_t(struct ephemeron) ephemerons;
+  struct guardian *guardians;   /* of live guardian objects */
+  kvec_t(struct finalizer) finalizers; /* queued by the sweeper */
+  bool finalizing;
+  bool fragmented;              /* class pages are sparse enough to be compacted */
+  bool compacting;              /* the current collection may move objects */
+  kvec_t(struct compact_page) compact; /* pages to be evacuated, by address */
+  kvec_t(struct pic_object *) pinners; /* objects that refer to others from outside the heap */
+  struct pic_gc_stats stats;
+  size_t sweep_objects[PIC_TT_CP + 1]; /* live objects found by the pending sweep so far */
+  pic_gc_hook_t hook;
+  void *hook_data;
+#if PIC_GC_THREADS > 0
+  struct gc_pool *pool;
+#endif
 };
 
+static void *
+heap_page_alloc(pic_state *pic, size_t size)
+{
+#if PIC_USE_MMAP
+  void *ptr;
+
+  ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ptr == MAP_FAILED) {
+    pic_panic(pic, "memory exhausted");
+  }
+  return ptr;
+#else
+  return pic_malloc(pic, size);
+#endif
+}
+
+static void
+heap_page_free(pic_state *pic, void *ptr, size_t size)
+{
+#if PIC_USE_MMAP
+  (void)pic;
+  munmap(ptr, size);
+#else
+  (void)size;
+  pic_free(pic, ptr);
+#endif
+}
+
+/**
+ * Large blocks are mapped one by one, so that freeing them returns the memory
+ * at once. Since mapping fresh pages is not cheap either, the blocks freed by
+ * a collection are kept aside for allocations of the same size until the
+ * sweep is over.
+ */
+
+#define LARGE_ROUND(size) (((size) + 4095) & ~(size_t)4095)
+
+static void *
+large_map(pic_state *pic, size_t size)
+{
+  struct large_object *block, **link;
+
+  if (size < PIC_HEAP_LARGE_SIZE) {
+    return pic_malloc(pic, size);
+  }
+  for (link = &pic->heap->spare; (block = *link) != NULL; link = &block->next) {
+    if (block->size == LARGE_ROUND(size)) {
+      *link = block->next;
+      return block;
+    }
+  }
+  return heap_page_alloc(pic, LARGE_ROUND(size));
+}
+
+static void
+large_unmap(pic_state *pic, void *ptr, size_t size)
+{
+  struct large_object *block = ptr;
+
+  if (size < PIC_HEAP_LARGE_SIZE) {
+    pic_free(pic, ptr);
+    return;
+  }
+  block->size = LARGE_ROUND(size);
+  block->next = pic->heap->spare;
+  pic->heap->spare = block;
+}
+
+static void
+large_release(pic_state *pic)
+{
+  struct large_object *block;
+
+  while ((block = pic->heap->spare) != NULL) {
+    pic->heap->spare = block->next;
+    heap_page_free(pic, block, block->size);
+  }
+}
+
 struct pic_heap *
 pic_heap_open(pic_state *pic)
 {
   struct pic_heap *heap;
+  size_t i;
 
   heap = pic_malloc(pic, sizeof(struct pic_heap));
 
-  heap->base.s.ptr = &heap->base;
-  heap->base.s.size = 0; /* not 1, since it must never be used for allocation */
+  heap->large = NULL;
+  heap->spare = NULL;
 
-  heap->freep = &heap->base;
-  heap->pages = NULL;
+  for (i = 0; i < CLASS_COUNT; ++i) {
+    heap->classes[i].size = (i + 1) * CLASS_UNIT;
+    if (heap->classes[i].size < sizeof(union slot)) {
+      heap->classes[i].size = sizeof(union slot);
+    }
+    heap->classes[i].freep = NULL;
+    heap->classes[i].pages = NULL;
+    heap->classes[i].sweep = NULL;
+  }
+  heap->size = 0;
+  heap->limit = 0;
+  heap->empty = NULL;
+  heap->nempty = 0;
+
+  pic->gc_black = PIC_GC_MARK;
+  heap->major = false;
+  heap->old_limit = 0;
+  heap->allocated = 0;
+  heap->marking = false;
+  heap->sweeping = false;
+  heap->sweep_major = false;
+  heap->sweep_live = 0;
+  heap->external = 0;
+  heap->external_debt = 0;
+  heap->external_limit = PIC_HEAP_PAGE_SIZE;
+  heap->debt = 0;
+  kv_init(heap->gray);
+  kv_init(heap->remembered);
+  kv_init(heap->shady);
 
   heap->regs = NULL;
+  heap->weak = false;
+  kh_init(eph, &heap->waiting);
+  kv_init(heap->ephemerons);
+  heap->guardians = NULL;
+  kv_init(heap->finalizers);
+  heap->finalizing = false;
+  heap->fragmented = false;
+  heap->compacting = false;
+  kv_init(heap->compact);
+  kv_init(heap->pinners);
+
+  memset(&heap->stats, 0, sizeof heap->stats);
+  memset(heap->sweep_objects, 0, sizeof heap->sweep_objects);
+  heap->hook = NULL;
+  heap->hook_data = NULL;
+
+#if PIC_GC_THREADS > 0
+  heap->pool = gc_pool_open(pic);
+#endif
 
   return heap;
 }
 
+static bool gc_sweep_finish(pic_state *);
+static void gc_run_finalizers(pic_state *);
+
 void
 pic_heap_close(pic_state *pic, struct pic_heap *heap)
 {
-  struct heap_page *page;
+  struct large_object *large;
+  struct class_page *cpage;
+  size_t i;
+
+#if PIC_GC_THREADS > 0
+  gc_pool_close(pic, heap->pool);
+#endif
+
+  gc_sweep_finish(pic);         /* finalize what the last collection left behind */
+  gc_run_finalizers(pic);
 
-  while (heap->pages) {
-    page = heap->pages;
-    heap->pages = heap->pages->next;
-    pic_free(pic, page->basep);
-    pic_free(pic, page);
+  while (heap->large) {
+    large = heap->large;
+    heap->large = large->next;
+    large_unmap(pic, large, large->size);
   }
+  large_release(pic);
+  for (i = 0; i < CLASS_COUNT; ++i) {
+    while (heap->classes[i].pages) {
+      cpage = heap->classes[i].pages;
+      heap->classes[i].pages = cpage->next;
+      heap_page_free(pic, cpage, PIC_HEAP_CLASS_PAGE_SIZE);
+    }
+  }
+  while (heap->empty) {
+    cpage = heap->empty;
+    heap->empty = cpage->next;
+    heap_page_free(pic, cpage, PIC_HEAP_CLASS_PAGE_SIZE);
+  }
+  kv_destroy(heap->gray);
+  kv_destroy(heap->remembered);
+  kv_destroy(heap->shady);
+  kh_destroy(eph, &heap->waiting);
+  kv_destroy(heap->ephemerons);
+  kv_destroy(heap->finalizers);
+  kv_destroy(heap->compact);
+  kv_destroy(heap->pinners);
   pic_free(pic, heap);
 }
 
@@ -166,97 +510,242 @@ pic_gc_arena_restore(pic_state *pic, size_t state)
   pic->arena_idx = state;
 }
 
-static void *
-heap_alloc(pic_state *pic, size_t size)
+/**
+ * Memory owned by a heap object outside the heap (the elements of a vector,
+ * the bytes of a bytevector or of a string) is allocated here, so that the
+ * collector knows about it. Allocating such memory adds to the debt that
+ * triggers the next collection; the owner must give the same size back to
+ * pic_gc_free when it is finalized, or to pic_gc_realloc to resize it.
+ */
+
+void *
+pic_gc_malloc(pic_state *pic, size_t size)
 {
-  union header *p, *prevp;
-  size_t nunits;
+  struct pic_heap *heap = pic->heap;
 
-  assert(size > 0);
+  heap->external += size;
+  heap->external_debt += size;
+  heap->allocated += size;
+  heap->stats.allocated += size;
+  return large_map(pic, size);
+}
 
-  nunits = (size + sizeof(union header) - 1) / sizeof(union header) + 1;
+void *
+pic_gc_realloc(pic_state *pic, void *ptr, size_t old, size_t size)
+{
+  struct pic_heap *heap = pic->heap;
+  void *p;
 
-  prevp = pic->heap->freep;
-  for (p = prevp->s.ptr; ; prevp = p, p = p->s.ptr) {
-    if (p->s.size >= nunits)
-      break;
-    if (p == pic->heap->freep) {
-      return NULL;
-    }
+  if (old < PIC_HEAP_LARGE_SIZE && size < PIC_HEAP_LARGE_SIZE) {
+    p = pic_realloc(pic, ptr, size);
+  } else {
+    p = large_map(pic, size);
+    memcpy(p, ptr, old < size ? old : size);
+    large_unmap(pic, ptr, old);
   }
-
-  if (p->s.size == nunits) {
-    prevp->s.ptr = p->s.ptr;
+  if (size > old) {
+    heap->external_debt += size - old;
+    heap->allocated += size - old;
+    heap->stats.allocated += size - old;
   }
-  else {
-    p->s.size -= nunits;
-    p += p->s.size;
-    p->s.size = nunits;
+  heap->external = heap->external - old + size;
+  return p;
+}
+
+void
+pic_gc_free(pic_state *pic, void *ptr, size_t size)
+{
+  pic->heap->external -= size;
+  large_unmap(pic, ptr, size);
+}
+
+static void *
+large_alloc(pic_state *pic, size_t size)
+{
+  struct pic_heap *heap = pic->heap;
+  struct large_object *large;
+
+  size += sizeof(struct large_object);
+
+  large = large_map(pic, size);
+  large->size = size;
+  large->next = heap->large;
+  heap->large = large;
+
+  heap->external += size;
+  heap->external_debt += size;
+  return large + 1;
+}
+
+static void gc_sweep_class_page(pic_state *, struct size_class *);
+
+/* puts a fresh page at the head of cls */
+static struct class_page *
+class_page_add(pic_state *pic, struct size_class *cls)
+{
+  struct pic_heap *heap = pic->heap;
+  struct class_page *page;
+  size_t offset;
+
+  if ((page = heap->empty) != NULL) {
+    heap->empty = page->next;
+    heap->nempty--;
+  } else {
+    page = heap_page_alloc(pic, PIC_HEAP_CLASS_PAGE_SIZE);
+    heap->size += PIC_HEAP_CLASS_PAGE_SIZE;
   }
-  pic->heap->freep = prevp;
+  offset = (sizeof(struct class_page) + CLASS_UNIT - 1) / CLASS_UNIT * CLASS_UNIT;
+
+  page->basep = page->topp = (char *)page + offset;
+  page->endp = (char *)page + PIC_HEAP_CLASS_PAGE_SIZE;
+  page->next = cls->pages;
 
-  return (void *)(p + 1);
+  cls->pages = page;
+  return page;
 }
 
-static void
-heap_free(pic_state *pic, void *ap)
+static void *
+class_alloc(pic_state *pic, struct size_class *cls)
 {
-  union header *bp, *p;
+  struct pic_heap *heap = pic->heap;
+  struct class_page *page;
+  union slot *s;
 
-  assert(ap != NULL);
+  while (cls->freep == NULL && cls->sweep != NULL) {
+    gc_sweep_class_page(pic, cls);
+  }
 
-  bp = (union header *)ap - 1;
+  if ((s = cls->freep) != NULL) {
+    cls->freep = s->free.next;
+    return s;
+  }
 
-  for (p = pic->heap->freep; ! (bp > p && bp < p->s.ptr); p = p->s.ptr) {
-    if (p >= p->s.ptr && (bp > p || bp < p->s.ptr)) {
-      break;
+  page = cls->pages;
+  if (page == NULL || page->topp + cls->size > page->endp) {
+    if (heap->size - heap->nempty * PIC_HEAP_CLASS_PAGE_SIZE + PIC_HEAP_CLASS_PAGE_SIZE > heap->limit) {
+      return NULL;
     }
+    page = class_page_add(pic, cls);
   }
-  if (bp + bp->s.size == p->s.ptr && p->s.ptr->s.size > 0) { /* don't melt base header */
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else {
-    bp->s.ptr = p->s.ptr;
-  }
-  if (p + p->s.size == bp && bp->s.size > 0) { /* don't melt base header */
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else {
-    p->s.ptr = bp;
+
+  s = (union slot *)page->topp;
+  page->topp += cls->size;
+  return s;
+}
+
+static void *
+heap_alloc(pic_state *pic, size_t size)
+{
+  assert(size > 0);
+
+  if (size <= PIC_HEAP_CLASS_MAX) {
+    return class_alloc(pic, &pic->heap->classes[CLASS_INDEX(size)]);
   }
-  pic->heap->freep = p;
+  return large_alloc(pic, size);
 }
 
 static void
 heap_morecore(pic_state *pic)
 {
-  union header *bp, *np;
-  struct heap_page *page;
-  size_t nunits;
-
-  nunits = PIC_HEAP_PAGE_SIZE / sizeof(union header);
+  struct pic_heap *heap = pic->heap;
 
-  assert(nunits >= 2);
+  if (heap->limit < heap->size - heap->nempty * PIC_HEAP_CLASS_PAGE_SIZE) {
+    heap->limit = heap->size - heap->nempty * PIC_HEAP_CLASS_PAGE_SIZE; /* the target may have shrunk */
+  }
+  heap->limit += PIC_HEAP_PAGE_SIZE;
+}
 
-  bp = pic_malloc(pic, PIC_HEAP_PAGE_SIZE);
-  bp->s.size = 0;               /* bp is never used for allocation */
-  heap_free(pic, bp + 1);
+/* BARRIER */
 
-  np = bp + 1;
-  np->s.size = nunits - 1;
-  heap_free(pic, np + 1);
+/* a whitened old object; still alive as far as the lazy sweeper is concerned */
+#define GC_REMEMBERED (PIC_GC_MARK + 2)
 
-  page = pic_malloc(pic, sizeof(struct heap_page));
-  page->basep = bp;
-  page->endp = bp + nunits;
-  page->next = pic->heap->pages;
+void
+pic_gc_remember(pic_state *pic, void *ptr)
+{
+  struct pic_object *obj = ptr;
 
-  pic->heap->pages = page;
+  if (obj->u.basic.gc_mark != pic->gc_black) {
+    return;                     /* young, remembered, or not traced yet */
+  }
+  if (pic->heap->marking && obj->u.basic.tt == PIC_TT_REG) {
+    return;                     /* already chained; entries are revisited at the end */
+  }
+  obj->u.basic.gc_mark = GC_REMEMBERED;
+  kv_push(struct pic_object *, pic->heap->remembered, obj);
 }
 
 /* MARK */
 
-static void gc_mark_object(pic_state *, struct pic_object *);
+#if PIC_GC_THREADS > 0
+
+static void
+gc_lock(pic_state *pic)
+{
+  if (gc_self != NULL) {
+    pthread_mutex_lock(&pic->heap->pool->lock);
+  }
+}
+
+static void
+gc_unlock(pic_state *pic)
+{
+  if (gc_self != NULL) {
+    pthread_mutex_unlock(&pic->heap->pool->lock);
+  }
+}
+
+#else
+# define gc_lock(pic) ((void)0)
+# define gc_unlock(pic) ((void)0)
+#endif
+
+static void
+gc_mark_object(pic_state *pic, struct pic_object *obj)
+{
+#if PIC_GC_THREADS > 0
+  char mark;
+#endif
+
+  if (obj->u.basic.gc_mark == pic->gc_black)
+    return;
+
+#if PIC_GC_THREADS > 0
+  if (gc_self != NULL) {
+    mark = obj->u.basic.gc_mark;
+    if (! __atomic_compare_exchange_n(&obj->u.basic.gc_mark, &mark, pic->gc_black, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      return;                   /* claimed by another worker */
+    }
+  } else {
+    obj->u.basic.gc_mark = pic->gc_black;
+  }
+#else
+  obj->u.basic.gc_mark = pic->gc_black;
+#endif
+
+  switch (obj->u.basic.tt) {
+  case PIC_TT_SYMBOL:
+  case PIC_TT_STRING:
+  case PIC_TT_BLOB:
+  case PIC_TT_PORT:
+    if (! pic->heap->weak)
+      break;                    /* no outgoing references, nor ephemerons to wake up */
+    /* fall through */
+  default:
+#if PIC_GC_THREADS > 0
+    if (gc_self != NULL) {
+      if (kv_size(gc_self->gray) == kv_max(gc_self->gray)) {
+        gc_lock(pic);           /* allocf may not be thread-safe */
+        kv_resize(struct pic_object *, gc_self->gray, kv_max(gc_self->gray) * 2 + GC_GRAIN);
+        gc_unlock(pic);
+      }
+      kv_A(gc_self->gray, kv_size(gc_self->gray)++) = obj;
+      break;
+    }
+#endif
+    kv_push(struct pic_object *, pic->heap->gray, obj);
+  }
+}
 
 static void
 gc_mark(pic_state *pic, pic_value v)
@@ -267,77 +756,102 @@ gc_mark(pic_state *pic, pic_value v)
   gc_mark_object(pic, pic_obj_ptr(v));
 }
 
+#define MARK(o) gc_mark_object(pic, (struct pic_object *)(o))
+
 static void
-gc_mark_object(pic_state *pic, struct pic_object *obj)
+gc_weak_scan(pic_state *pic, struct pic_reg *reg)
+{
+  struct pic_heap *heap = pic->heap;
+  khash_t(reg) *h = &reg->hash;
+  struct pic_object *key;
+  struct ephemeron e;
+  pic_value val;
+  khiter_t it, k;
+  int ret;
+
+  for (it = kh_begin(h); it != kh_end(h); ++it) {
+    if (! kh_exist(h, it))
+      continue;
+    key = kh_key(h, it);
+    val = kh_val(h, it);
+    if (! pic_obj_p(val) || pic_obj_ptr(val)->u.basic.gc_mark == pic->gc_black)
+      continue;
+    if (key->u.basic.gc_mark == pic->gc_black) {
+      gc_mark(pic, val);
+      continue;
+    }
+    k = kh_put(eph, &heap->waiting, key, &ret);
+    e.val = val;
+    e.next = ret == 0 ? kh_val(&heap->waiting, k) : EPHEMERON_NONE;
+    kh_val(&heap->waiting, k) = kv_size(heap->ephemerons);
+    kv_push(struct ephemeron, heap->ephemerons, e);
+  }
+}
+
+/* marks the values of the entries that were waiting for key */
+static void
+gc_weak_wake(pic_state *pic, struct pic_object *key)
 {
- loop:
+  struct pic_heap *heap = pic->heap;
+  khiter_t k;
+  size_t i;
 
-  if (obj->u.basic.gc_mark == PIC_GC_MARK)
+  if ((k = kh_get(eph, &heap->waiting, key)) == kh_end(&heap->waiting))
     return;
+  for (i = kh_val(&heap->waiting, k); i != EPHEMERON_NONE; i = kv_A(heap->ephemerons, i).next) {
+    gc_mark(pic, kv_A(heap->ephemerons, i).val);
+  }
+  kh_del(eph, &heap->waiting, k);
+}
 
-  obj->u.basic.gc_mark = PIC_GC_MARK;
-
-#define LOOP(o) obj = (struct pic_object *)(o); goto loop
+/* marks the children of a gray object and returns the amount of work done */
+static size_t
+gc_scan_object(pic_state *pic, struct pic_object *obj)
+{
+  if (pic->heap->weak && kh_size(&pic->heap->waiting) > 0) {
+    gc_weak_wake(pic, obj);
+  }
 
   switch (obj->u.basic.tt) {
   case PIC_TT_PAIR: {
+    gc_mark(pic, obj->u.pair.cdr);
     gc_mark(pic, obj->u.pair.car);
-    if (pic_obj_p(obj->u.pair.cdr)) {
-      LOOP(pic_obj_ptr(obj->u.pair.cdr));
-    }
-    break;
-  }
-  case PIC_TT_CXT: {
-    int i;
-
-    for (i = 0; i < obj->u.cxt.regc; ++i) {
-      gc_mark(pic, obj->u.cxt.regs[i]);
-    }
-    if (obj->u.cxt.up) {
-      LOOP(obj->u.cxt.up);
-    }
-    break;
+    return 2;
   }
   case PIC_TT_PROC: {
     if (pic_proc_irep_p(&obj->u.proc)) {
-      gc_mark_object(pic, (struct pic_object *)obj->u.proc.u.i.irep);
-      if (obj->u.proc.u.i.cxt) {
-        LOOP(obj->u.proc.u.i.cxt);
+      int i, n = obj->u.proc.u.i.irep->freec;
+
+      MARK(obj->u.proc.u.i.irep);
+      for (i = 0; i < n; ++i) {
+        gc_mark(pic, obj->u.proc.fv[i]);
       }
+      return n + 2;
     } else {
       if (obj->u.proc.u.f.env) {
-        LOOP(obj->u.proc.u.f.env);
+        MARK(obj->u.proc.u.f.env);
       }
     }
-    break;
-  }
-  case PIC_TT_PORT: {
-    break;
+    return 2;
   }
   case PIC_TT_ERROR: {
-    gc_mark_object(pic, (struct pic_object *)obj->u.err.type);
-    gc_mark_object(pic, (struct pic_object *)obj->u.err.msg);
+    MARK(obj->u.err.type);
+    MARK(obj->u.err.msg);
     gc_mark(pic, obj->u.err.irrs);
-    LOOP(obj->u.err.stack);
-    break;
-  }
-  case PIC_TT_STRING: {
-    break;
+    MARK(obj->u.err.stack);
+    return 4;
   }
   case PIC_TT_VECTOR: {
     int i;
     for (i = 0; i < obj->u.vec.len; ++i) {
       gc_mark(pic, obj->u.vec.data[i]);
     }
-    break;
-  }
-  case PIC_TT_BLOB: {
-    break;
+    return obj->u.vec.len + 1;
   }
   case PIC_TT_ID: {
     gc_mark(pic, obj->u.id.var);
-    LOOP(obj->u.id.env);
-    break;
+    MARK(obj->u.id.env);
+    return 2;
   }
   case PIC_TT_ENV: {
     khash_t(env) *h = &obj->u.env.map;
@@ -345,82 +859,96 @@ gc_mark_object(pic_state *pic, struct pic_object *obj)
 
     for (it = kh_begin(h); it != kh_end(h); ++it) {
       if (kh_exist(h, it)) {
-        gc_mark_object(pic, kh_key(h, it));
-        gc_mark_object(pic, (struct pic_object *)kh_val(h, it));
+        MARK(kh_key(h, it));
+        MARK(kh_val(h, it));
       }
     }
     if (obj->u.env.up) {
-      LOOP(obj->u.env.up);
+      MARK(obj->u.env.up);
     }
-    break;
+    return kh_size(h) * 2 + 1;
   }
   case PIC_TT_LIB: {
     gc_mark(pic, obj->u.lib.name);
-    gc_mark_object(pic, (struct pic_object *)obj->u.lib.env);
-    LOOP(obj->u.lib.exports);
-    break;
+    MARK(obj->u.lib.env);
+    MARK(obj->u.lib.exports);
+    return 3;
   }
   case PIC_TT_IREP: {
     size_t i;
 
     for (i = 0; i < obj->u.irep.ilen; ++i) {
-      gc_mark_object(pic, (struct pic_object *)obj->u.irep.irep[i]);
+      MARK(obj->u.irep.irep[i]);
     }
     for (i = 0; i < obj->u.irep.plen; ++i) {
       gc_mark(pic, obj->u.irep.pool[i]);
     }
-    break;
+    for (i = 0; i < obj->u.irep.cachelen; ++i) {
+      if (obj->u.irep.cache[i] != NULL) {
+        MARK(obj->u.irep.cache[i]);
+      }
+    }
+    return obj->u.irep.ilen + obj->u.irep.plen + obj->u.irep.cachelen + 1;
   }
   case PIC_TT_DATA: {
     if (obj->u.data.type->mark) {
       obj->u.data.type->mark(pic, obj->u.data.data, gc_mark);
+      gc_lock(pic);
+      kv_push(struct pic_object *, pic->heap->shady, obj);
+      gc_unlock(pic);
     }
-    LOOP(obj->u.data.storage);
-    break;
+    MARK(obj->u.data.storage);
+    return 2;
   }
   case PIC_TT_DICT: {
     pic_sym *sym;
     khiter_t it;
 
     pic_dict_for_each (sym, &obj->u.dict, it) {
-      gc_mark_object(pic, (struct pic_object *)sym);
+      MARK(sym);
       gc_mark(pic, pic_dict_ref(pic, &obj->u.dict, sym));
     }
-    break;
+    return pic_dict_size(pic, &obj->u.dict) * 2 + 1;
   }
   case PIC_TT_RECORD: {
-    gc_mark_object(pic, (struct pic_object *)obj->u.rec.type);
-    LOOP(obj->u.rec.data);
-    break;
-  }
-  case PIC_TT_SYMBOL: {
-    break;
+    MARK(obj->u.rec.type);
+    MARK(obj->u.rec.data);
+    return 2;
   }
   case PIC_TT_REG: {
     struct pic_reg *reg = (struct pic_reg *)obj;
 
+    gc_lock(pic);
     reg->prev = pic->heap->regs;
     pic->heap->regs = reg;
-    break;
+    gc_unlock(pic);
+    if (pic->heap->weak) {
+      gc_weak_scan(pic, reg);
+      return kh_size(&reg->hash) + 1;
+    }
+    return 1;
   }
   case PIC_TT_BOX: {
-    if (pic_obj_p(obj->u.box.value)) {
-      LOOP(pic_obj_ptr(obj->u.box.value));
-    }
-    break;
+    gc_mark(pic, obj->u.box.value);
+    return 1;
   }
   case PIC_TT_CP: {
     if (obj->u.cp.prev) {
-      gc_mark_object(pic, (struct pic_object *)obj->u.cp.prev);
+      MARK(obj->u.cp.prev);
     }
     if (obj->u.cp.in) {
-      gc_mark_object(pic, (struct pic_object *)obj->u.cp.in);
+      MARK(obj->u.cp.in);
     }
     if (obj->u.cp.out) {
-      LOOP((struct pic_object *)obj->u.cp.out);
+      MARK(obj->u.cp.out);
     }
-    break;
+    return 3;
   }
+  case PIC_TT_SYMBOL:
+  case PIC_TT_STRING:
+  case PIC_TT_BLOB:
+  case PIC_TT_PORT:
+    return 1;
   case PIC_TT_NIL:
   case PIC_TT_BOOL:
   case PIC_TT_FLOAT:
@@ -431,37 +959,216 @@ gc_mark_object(pic_state *pic, struct pic_object *obj)
   case PIC_TT_INVALID:
     pic_panic(pic, "logic flaw");
   }
+  return 0;
 }
 
-#define M(x) gc_mark_object(pic, (struct pic_object *)pic->x)
-#define P(x) gc_mark(pic, pic->x)
+#if PIC_GC_THREADS > 0
 
-static void
-gc_mark_phase(pic_state *pic)
+/* called with the pool lock held; false when every worker has run dry */
+static bool
+gc_worker_take(pic_state *pic, struct gc_worker *w)
 {
-  pic_value *stack;
-  pic_callinfo *ci;
-  struct pic_proc **xhandler;
-  size_t j;
-
-  assert(pic->heap->regs == NULL);
-
-  /* checkpoint */
-  if (pic->cp) {
-    gc_mark_object(pic, (struct pic_object *)pic->cp);
+  struct gc_pool *pool = w->pool;
+  size_t n;
+
+  pool->idle++;
+  while (kv_size(pool->shared) == 0) {
+    if (pool->idle == PIC_GC_THREADS + 1) {
+      pthread_cond_broadcast(&pool->work);
+      return false;
+    }
+    pthread_cond_wait(&pool->work, &pool->lock);
   }
+  pool->idle--;
 
-  /* stack */
-  for (stack = pic->stbase; stack != pic->sp; ++stack) {
-    gc_mark(pic, *stack);
+  for (n = 0; n < GC_GRAIN && kv_size(pool->shared) > 0; ++n) {
+    kv_push(struct pic_object *, w->gray, kv_pop(pool->shared));
   }
+  return true;
+}
+
+static void
+gc_worker_drain(pic_state *pic, struct gc_worker *w)
+{
+  struct gc_pool *pool = w->pool;
+  size_t n;
+  bool more;
+
+  do {
+    while (kv_size(w->gray) > 0) {
+      gc_scan_object(pic, kv_pop(w->gray));
+
+      if (kv_size(w->gray) > GC_GRAIN * 2 && __atomic_load_n(&pool->idle, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        for (n = 0; n < GC_GRAIN; ++n) {
+          kv_push(struct pic_object *, pool->shared, kv_pop(w->gray));
+        }
+        pthread_cond_signal(&pool->work);
+        pthread_mutex_unlock(&pool->lock);
+      }
+    }
+    pthread_mutex_lock(&pool->lock);
+    more = gc_worker_take(pic, w);
+    pthread_mutex_unlock(&pool->lock);
+  } while (more);
+}
+
+static void *
+gc_worker_main(void *arg)
+{
+  struct gc_worker *w = arg;
+  struct gc_pool *pool = w->pool;
+  unsigned long epoch = 0;
+
+  gc_self = w;
+
+  pthread_mutex_lock(&pool->lock);
+  while (1) {
+    while (pool->epoch == epoch && ! pool->quit) {
+      pthread_cond_wait(&pool->start, &pool->lock);
+    }
+    if (pool->quit) {
+      break;
+    }
+    epoch = pool->epoch;
+    pthread_mutex_unlock(&pool->lock);
+
+    gc_worker_drain(pool->pic, w);
 
-  /* callinfo */
-  for (ci = pic->ci; ci != pic->cibase; --ci) {
-    if (ci->cxt) {
-      gc_mark_object(pic, (struct pic_object *)ci->cxt);
+    pthread_mutex_lock(&pool->lock);
+    if (--pool->running == 0) {
+      pthread_cond_signal(&pool->done);
     }
   }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+static void
+gc_mark_parallel(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct gc_pool *pool = heap->pool;
+
+  pthread_mutex_lock(&pool->lock);
+  while (kv_size(heap->gray) > 0) {
+    kv_push(struct pic_object *, pool->shared, kv_pop(heap->gray));
+  }
+  pool->idle = 0;
+  pool->running = PIC_GC_THREADS;
+  pool->epoch++;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  gc_self = &pool->workers[0];
+  gc_worker_drain(pic, gc_self);
+  gc_self = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  while (pool->running > 0) {
+    pthread_cond_wait(&pool->done, &pool->lock);
+  }
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static struct gc_pool *
+gc_pool_open(pic_state *pic)
+{
+  struct gc_pool *pool;
+  int i;
+
+  pool = pic_malloc(pic, sizeof(struct gc_pool));
+  pool->pic = pic;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->start, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  kv_init(pool->shared);
+  pool->epoch = 0;
+  pool->idle = 0;
+  pool->running = 0;
+  pool->quit = false;
+
+  for (i = 0; i <= PIC_GC_THREADS; ++i) {
+    pool->workers[i].pool = pool;
+    kv_init(pool->workers[i].gray);
+  }
+  for (i = 1; i <= PIC_GC_THREADS; ++i) {
+    if (pthread_create(&pool->workers[i].thread, NULL, gc_worker_main, &pool->workers[i]) != 0) {
+      pic_panic(pic, "failed to start a marker thread");
+    }
+  }
+  return pool;
+}
+
+static void
+gc_pool_close(pic_state *pic, struct gc_pool *pool)
+{
+  int i;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->start);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (i = 1; i <= PIC_GC_THREADS; ++i) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+  for (i = 0; i <= PIC_GC_THREADS; ++i) {
+    kv_destroy(pool->workers[i].gray);
+  }
+  kv_destroy(pool->shared);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->start);
+  pthread_cond_destroy(&pool->work);
+  pthread_cond_destroy(&pool->done);
+  pic_free(pic, pool);
+}
+
+#endif
+
+/* scans gray objects until the budget is used up; true when none is left */
+static bool
+gc_mark_drain(pic_state *pic, size_t budget)
+{
+  struct pic_heap *heap = pic->heap;
+  size_t work = 0;
+
+  while (kv_size(heap->gray) > 0) {
+    if (work >= budget) {
+      return false;
+    }
+#if PIC_GC_THREADS > 0
+    if (budget == (size_t)-1 && kv_size(heap->gray) >= GC_GRAIN * 2 && ! heap->weak) {
+      gc_mark_parallel(pic);
+      break;
+    }
+#endif
+    work += gc_scan_object(pic, kv_pop(heap->gray));
+  }
+  return true;
+}
+
+#define M(x) gc_mark_object(pic, (struct pic_object *)pic->x)
+#define P(x) gc_mark(pic, pic->x)
+
+static void
+gc_mark_roots(pic_state *pic)
+{
+  pic_value *stack;
+  struct pic_proc **xhandler;
+  size_t j;
+
+  /* checkpoint */
+  if (pic->cp) {
+    gc_mark_object(pic, (struct pic_object *)pic->cp);
+  }
+
+  /* stack */
+  for (stack = pic->stbase; stack != pic->sp; ++stack) {
+    gc_mark(pic, *stack);
+  }
 
   /* exception handlers */
   for (xhandler = pic->xpbase; xhandler != pic->xp; ++xhandler) {
@@ -473,6 +1180,13 @@ gc_mark_phase(pic_state *pic)
     gc_mark_object(pic, (struct pic_object *)pic->arena[j]);
   }
 
+  /* procedures sampled by the allocation profiler */
+  if (pic->prof) {
+    for (j = 0; j < kv_size(pic->prof->frames); ++j) {
+      gc_mark_object(pic, kv_A(pic->prof->frames, j));
+    }
+  }
+
   /* mark reserved symbols */
   M(sQUOTE); M(sQUASIQUOTE); M(sUNQUOTE); M(sUNQUOTE_SPLICING);
   M(sSYNTAX_QUOTE); M(sSYNTAX_QUASIQUOTE); M(sSYNTAX_UNQUOTE); M(sSYNTAX_UNQUOTE_SPLICING);
@@ -482,14 +1196,14 @@ gc_mark_phase(pic_state *pic)
   M(uDEFINE_LIBRARY); M(uIMPORT); M(uEXPORT); M(uCOND_EXPAND);
 
   M(uCONS); M(uCAR); M(uCDR); M(uNILP); M(uSYMBOLP); M(uPAIRP);
-  M(uADD); M(uSUB); M(uMUL); M(uDIV); M(uEQ); M(uLT); M(uLE); M(uGT); M(uGE); M(uNOT);
+  M(uADD); M(uSUB); M(uMUL); M(uDIV); M(uEQ); M(uLT); M(uLE); M(uGT); M(uGE); M(uNOT); M(uAPPLY);
 
   /* mark system procedures */
   P(pCONS); P(pCAR); P(pCDR); P(pNILP); P(pSYMBOLP); P(pPAIRP); P(pNOT);
-  P(pADD); P(pSUB); P(pMUL); P(pDIV); P(pEQ); P(pLT); P(pLE); P(pGT); P(pGE);
+  P(pADD); P(pSUB); P(pMUL); P(pDIV); P(pEQ); P(pLT); P(pLE); P(pGT); P(pGE); P(pAPPLY);
 
   M(cCONS); M(cCAR); M(cCDR); M(cNILP); M(cSYMBOLP); M(cPAIRP); M(cNOT);
-  M(cADD); M(cSUB); M(cMUL); M(cDIV); M(cEQ); M(cLT); M(cLE); M(cGT); M(cGE);
+  M(cADD); M(cSUB); M(cMUL); M(cDIV); M(cEQ); M(cLT); M(cLE); M(cGT); M(cGE); M(cAPPLY);
 
   /* global variables */
   if (pic->globals) {
@@ -517,35 +1231,536 @@ gc_mark_phase(pic_state *pic)
 
   /* parameter table */
   gc_mark(pic, pic->ptable);
+}
 
-  /* registries */
-  do {
-    struct pic_object *key;
-    pic_value val;
-    khiter_t it;
-    khash_t(reg) *h;
-    struct pic_reg *reg;
+static void
+gc_mark_start(pic_state *pic, bool major)
+{
+  struct pic_heap *heap = pic->heap;
+  size_t j;
 
-    j = 0;
-    reg = pic->heap->regs;
+  assert(heap->regs == NULL);
+  assert(kv_size(heap->gray) == 0);
+  assert(! heap->sweeping);
 
-    while (reg != NULL) {
-      h = &reg->hash;
-      for (it = kh_begin(h); it != kh_end(h); ++it) {
-        if (! kh_exist(h, it))
+  if (major) {
+    pic->gc_black = pic->gc_black == PIC_GC_MARK ? PIC_GC_MARK + 1 : PIC_GC_MARK;
+    for (j = 0; j < kv_size(heap->remembered); ++j) {
+      kv_A(heap->remembered, j)->u.basic.gc_mark = PIC_GC_UNMARK;
+    }
+    heap->allocated = 0;
+    kv_size(heap->remembered) = 0;
+    kv_size(heap->shady) = 0;
+  }
+  heap->external_debt = 0;
+}
+
+/* resurrects the unreachable objects registered to live guardians, and forgets dead guardians */
+static void
+gc_mark_guardians(pic_state *pic)
+{
+  struct guardian *g, **link = &pic->heap->guardians;
+  struct pic_object *obj;
+  size_t i, n;
+
+  while ((g = *link) != NULL) {
+    if (g->owner->gc_mark != pic->gc_black) {
+      *link = g->next;
+      continue;
+    }
+    for (i = n = 0; i < kv_size(g->objects); ++i) {
+      obj = kv_A(g->objects, i);
+      if (obj->u.basic.gc_mark == pic->gc_black) {
+        kv_A(g->objects, n++) = obj;
+      } else {
+        kv_push(struct pic_object *, g->ready, obj);
+        gc_mark_object(pic, obj);
+      }
+    }
+    kv_size(g->objects) = n;
+    link = &g->next;
+  }
+}
+
+/* the final, atomic part of marking */
+static void
+gc_mark_finish(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct pic_object *obj;
+  struct pic_reg *reg;
+  size_t j, n;
+
+  /* data objects are re-traced; they are pushed back while being scanned */
+  n = kv_size(heap->shady);
+  for (j = 0; j < n; ++j) {
+    obj = kv_A(heap->shady, j);
+    obj->u.basic.gc_mark = PIC_GC_UNMARK;
+    gc_mark_object(pic, obj);
+  }
+  gc_mark_drain(pic, (size_t)-1);
+  for (j = n; j < kv_size(heap->shady); ++j) {
+    kv_A(heap->shady, j - n) = kv_A(heap->shady, j);
+  }
+  kv_size(heap->shady) -= n;
+
+  /* remembered set */
+  for (j = 0; j < kv_size(heap->remembered); ++j) {
+    gc_mark_object(pic, kv_A(heap->remembered, j));
+  }
+  kv_size(heap->remembered) = 0;
+
+  gc_mark_roots(pic);
+  gc_mark_drain(pic, (size_t)-1);
+
+  /* registries, including those reached from their own values */
+  heap->weak = true;
+  for (reg = heap->regs; reg != NULL; reg = reg->prev) {
+    gc_weak_scan(pic, reg);
+  }
+  gc_mark_drain(pic, (size_t)-1);
+  gc_mark_guardians(pic);
+  gc_mark_drain(pic, (size_t)-1);
+  heap->weak = false;
+
+  kh_clear(eph, &heap->waiting);
+  kv_size(heap->ephemerons) = 0;
+}
+
+/* COMPACT */
+
+/**
+ * Compaction moves the live objects of sparsely used class pages to fresh
+ * pages, in address order, and leaves their new address behind. Only plain
+ * data (pairs, vectors, strings, bytevectors and records) is ever moved. A
+ * page stays where it is when something might point into it from memory
+ * that cannot be updated: the arena, the native stack (scanned
+ * conservatively), whatever a data object marks, and the keys of registries,
+ * which are hashed by address. C code may also keep values where the
+ * collector cannot see them at all, so objects are moved only by pic_gc_run,
+ * never by a collection that an allocation has triggered.
+ */
+
+#define GC_FORWARDED (PIC_GC_MARK + 3)
+
+static bool
+gc_movable_p(struct pic_object *obj)
+{
+  switch (obj->u.basic.tt) {
+  case PIC_TT_PAIR:
+  case PIC_TT_VECTOR:
+  case PIC_TT_STRING:
+  case PIC_TT_BLOB:
+  case PIC_TT_RECORD:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static void
+gc_pin_address(pic_state *pic, const void *ptr)
+{
+  struct pic_heap *heap = pic->heap;
+  const char *p = ptr;
+  size_t lo = 0, hi = kv_size(heap->compact), mid;
+  char *page;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    page = (char *)kv_A(heap->compact, mid).page;
+    if (p < page) {
+      hi = mid;
+    } else if (p >= page + PIC_HEAP_CLASS_PAGE_SIZE) {
+      lo = mid + 1;
+    } else {
+      kv_A(heap->compact, mid).pinned = true;
+      return;
+    }
+  }
+}
+
+static void
+gc_pin_value(pic_state *pic, pic_value v)
+{
+  if (pic_obj_p(v)) {
+    gc_pin_address(pic, pic_obj_ptr(v));
+  }
+}
+
+#if defined(__SANITIZE_ADDRESS__)
+__attribute__((no_sanitize_address))
+#endif
+static void
+gc_pin_range(pic_state *pic, const char *from, const char *to)
+{
+  const char *p;
+  void *w;
+
+  for (p = from; p + sizeof(void *) <= to; p += sizeof(void *)) {
+    w = *(void *const *)p;
+    gc_pin_address(pic, w);
+#if PIC_NAN_BOXING
+    gc_pin_address(pic, pic_ptr((pic_value)w));
+#endif
+  }
+}
+
+void
+pic_gc_pin(pic_state *pic, const void *ptr, size_t size)
+{
+  if (kv_size(pic->heap->compact) == 0) {
+    return;                     /* no compaction in progress */
+  }
+  gc_pin_range(pic, ptr, (const char *)ptr + size);
+}
+
+/* scans from its own frame, so that it covers the registers its caller spilled */
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void
+gc_pin_native_stack(pic_state *pic)
+{
+  char here, *from, *to;
+
+  from = &here;
+  to = pic->native_stack_start;
+  if (from > to) {
+    from = to;
+    to = &here + 1;
+  }
+  from += (sizeof(void *) - (size_t)from % sizeof(void *)) % sizeof(void *);
+  gc_pin_range(pic, from, to);
+}
+
+static void
+gc_pin_stack(pic_state *pic)
+{
+  volatile char keep = 0;       /* no tail call: this frame must outlive the scan */
+#if defined(__GNUC__)
+  /* a jmp_buf would not do, as glibc mangles the stack and frame pointers it saves */
+  __builtin_unwind_init();      /* spills every callee-saved register */
+#else
+  PIC_JMPBUF regs;
+
+  PIC_SETJMP(pic, regs);
+#endif
+
+  gc_pin_native_stack(pic);
+  (void)keep;
+}
+
+/* collects sparse pages, and the objects that refer to others from outside the heap */
+static void
+gc_compact_select(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct size_class *cls;
+  struct class_page *page;
+  struct large_object *large;
+  struct compact_page c, t;
+  struct pic_object *obj;
+  size_t i, j, k, gap, live;
+  char *p, black = pic->gc_black;
+
+  for (i = 0; i < CLASS_COUNT; ++i) {
+    cls = &heap->classes[i];
+    for (page = cls->pages; page != NULL; page = page->next) {
+      live = 0;
+      for (p = page->basep; p != page->topp; p += cls->size) {
+        obj = (struct pic_object *)p;
+        if (obj->u.basic.tt == PIC_TT_INVALID || obj->u.basic.gc_mark != black) {
           continue;
-        key = kh_key(h, it);
-        val = kh_val(h, it);
-        if (key->u.basic.gc_mark == PIC_GC_MARK) {
-          if (pic_obj_p(val) && pic_obj_ptr(val)->u.basic.gc_mark == PIC_GC_UNMARK) {
-            gc_mark(pic, val);
-            ++j;
-          }
+        }
+        live += cls->size;
+        if ((obj->u.basic.tt == PIC_TT_DATA && obj->u.data.type->mark) || obj->u.basic.tt == PIC_TT_REG) {
+          kv_push(struct pic_object *, heap->pinners, obj);
+        }
+      }
+      if (live > 0 && (size_t)(page->endp - page->basep - live) * 100 > (size_t)(page->endp - page->basep) * PIC_GC_COMPACT) {
+        c.page = page;
+        c.cls = cls;
+        c.pinned = false;
+        kv_push(struct compact_page, heap->compact, c);
+      }
+    }
+  }
+  for (large = heap->large; large != NULL; large = large->next) {
+    obj = (struct pic_object *)(large + 1);
+    if (obj->u.basic.gc_mark == black && ((obj->u.basic.tt == PIC_TT_DATA && obj->u.data.type->mark) || obj->u.basic.tt == PIC_TT_REG)) {
+      kv_push(struct pic_object *, heap->pinners, obj);
+    }
+  }
+
+  /* sorted by address for gc_pin_address */
+  for (gap = kv_size(heap->compact) / 2; gap > 0; gap /= 2) {
+    for (j = gap; j < kv_size(heap->compact); ++j) {
+      t = kv_A(heap->compact, j);
+      for (k = j; k >= gap && (char *)kv_A(heap->compact, k - gap).page > (char *)t.page; k -= gap) {
+        kv_A(heap->compact, k) = kv_A(heap->compact, k - gap);
+      }
+      kv_A(heap->compact, k) = t;
+    }
+  }
+}
+
+static void
+gc_compact_pin(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct pic_object *obj;
+  khash_t(reg) *h;
+  khiter_t it;
+  size_t i;
+
+  for (i = 0; i < pic->arena_idx; ++i) {
+    gc_pin_address(pic, pic->arena[i]);
+  }
+
+  gc_pin_stack(pic);
+
+  for (i = 0; i < kv_size(heap->pinners); ++i) {
+    obj = kv_A(heap->pinners, i);
+    if (obj->u.basic.tt == PIC_TT_DATA) {
+      obj->u.data.type->mark(pic, obj->u.data.data, gc_pin_value);
+    } else {
+      h = &obj->u.reg.hash;
+      for (it = kh_begin(h); it != kh_end(h); ++it) {
+        if (kh_exist(h, it)) {
+          gc_pin_address(pic, kh_key(h, it));
         }
       }
-      reg = reg->prev;
     }
-  } while (j > 0);
+  }
+}
+
+static void
+gc_compact_evacuate(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct class_page *dst[CLASS_COUNT];
+  struct compact_page *c;
+  struct pic_object *obj;
+  size_t i, n;
+  char *p;
+
+  for (i = 0; i < CLASS_COUNT; ++i) {
+    dst[i] = NULL;
+  }
+  for (n = 0; n < kv_size(heap->compact); ++n) {
+    c = &kv_A(heap->compact, n);
+    if (c->pinned) {
+      continue;
+    }
+    i = c->cls - heap->classes;
+    for (p = c->page->basep; p != c->page->topp; p += c->cls->size) {
+      obj = (struct pic_object *)p;
+      if (obj->u.basic.tt == PIC_TT_INVALID || obj->u.basic.gc_mark != pic->gc_black || ! gc_movable_p(obj)) {
+        continue;
+      }
+      if (dst[i] == NULL || dst[i]->topp + c->cls->size > dst[i]->endp) {
+        dst[i] = class_page_add(pic, c->cls);
+      }
+      memcpy(dst[i]->topp, obj, c->cls->size);
+      obj->u.basic.gc_mark = GC_FORWARDED;
+      ((union slot *)obj)->free.next = (union slot *)dst[i]->topp;
+      dst[i]->topp += c->cls->size;
+    }
+  }
+}
+
+static void *
+gc_forward(void *ptr)
+{
+  struct pic_object *obj = ptr;
+
+  if (obj != NULL && obj->u.basic.gc_mark == GC_FORWARDED) {
+    return ((union slot *)obj)->free.next;
+  }
+  return obj;
+}
+
+static void
+gc_update(pic_value *v)
+{
+  if (pic_obj_p(*v) && pic_obj_ptr(*v)->u.basic.gc_mark == GC_FORWARDED) {
+    *v = pic_obj_value(gc_forward(pic_obj_ptr(*v)));
+  }
+}
+
+static void
+gc_update_object(pic_state *pic, struct pic_object *obj)
+{
+  switch (obj->u.basic.tt) {
+  case PIC_TT_PAIR: {
+    gc_update(&obj->u.pair.car);
+    gc_update(&obj->u.pair.cdr);
+    break;
+  }
+  case PIC_TT_PROC: {
+    int i;
+
+    if (pic_proc_irep_p(&obj->u.proc)) {
+      for (i = 0; i < obj->u.proc.u.i.irep->freec; ++i) {
+        gc_update(&obj->u.proc.fv[i]);
+      }
+    }
+    break;
+  }
+  case PIC_TT_VECTOR: {
+    int i;
+
+    for (i = 0; i < obj->u.vec.len; ++i) {
+      gc_update(&obj->u.vec.data[i]);
+    }
+    break;
+  }
+  case PIC_TT_ERROR: {
+    obj->u.err.msg = gc_forward(obj->u.err.msg);
+    obj->u.err.stack = gc_forward(obj->u.err.stack);
+    gc_update(&obj->u.err.irrs);
+    break;
+  }
+  case PIC_TT_ID: {
+    gc_update(&obj->u.id.var);
+    break;
+  }
+  case PIC_TT_LIB: {
+    gc_update(&obj->u.lib.name);
+    break;
+  }
+  case PIC_TT_IREP: {
+    size_t i;
+
+    for (i = 0; i < obj->u.irep.plen; ++i) {
+      gc_update(&obj->u.irep.pool[i]);
+    }
+    break;
+  }
+  case PIC_TT_DICT: {
+    khash_t(dict) *h = &obj->u.dict.hash;
+    khiter_t it;
+
+    for (it = kh_begin(h); it != kh_end(h); ++it) {
+      if (kh_exist(h, it)) {
+        gc_update(&kh_val(h, it));
+      }
+    }
+    break;
+  }
+  case PIC_TT_REG: {
+    khash_t(reg) *h = &obj->u.reg.hash;
+    khiter_t it;
+
+    for (it = kh_begin(h); it != kh_end(h); ++it) {
+      if (kh_exist(h, it)) {
+        gc_update(&kh_val(h, it));
+      }
+    }
+    break;
+  }
+  case PIC_TT_RECORD: {
+    obj->u.rec.type = gc_forward(obj->u.rec.type);
+    break;
+  }
+  case PIC_TT_BOX: {
+    gc_update(&obj->u.box.value);
+    break;
+  }
+  case PIC_TT_DATA:             /* whatever it refers to is pinned */
+  case PIC_TT_SYMBOL:
+  case PIC_TT_STRING:
+  case PIC_TT_BLOB:
+  case PIC_TT_PORT:
+  case PIC_TT_ENV:
+  case PIC_TT_CP:
+    break;
+  case PIC_TT_NIL:
+  case PIC_TT_BOOL:
+  case PIC_TT_FLOAT:
+  case PIC_TT_INT:
+  case PIC_TT_CHAR:
+  case PIC_TT_EOF:
+  case PIC_TT_UNDEF:
+  case PIC_TT_INVALID:
+    pic_panic(pic, "logic flaw");
+  }
+}
+
+#define U(x) gc_update(&pic->x)
+
+static void
+gc_compact_update(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct size_class *cls;
+  struct class_page *page;
+  struct large_object *large;
+  struct pic_object *obj;
+  struct guardian *g;
+  pic_value *stack;
+  khash_t(read) *h = &pic->reader.labels;
+  khiter_t it;
+  size_t i;
+  char *p, black = pic->gc_black;
+
+  for (stack = pic->stbase; stack != pic->sp; ++stack) {
+    gc_update(stack);
+  }
+  for (it = kh_begin(h); it != kh_end(h); ++it) {
+    if (kh_exist(h, it)) {
+      gc_update(&kh_val(h, it));
+    }
+  }
+
+  U(pCONS); U(pCAR); U(pCDR); U(pNILP); U(pSYMBOLP); U(pPAIRP); U(pNOT);
+  U(pADD); U(pSUB); U(pMUL); U(pDIV); U(pEQ); U(pLT); U(pLE); U(pGT); U(pGE); U(pAPPLY);
+
+  U(ptable); U(features); U(libs); U(err);
+
+  for (g = heap->guardians; g != NULL; g = g->next) {
+    for (i = 0; i < kv_size(g->objects); ++i) {
+      kv_A(g->objects, i) = gc_forward(kv_A(g->objects, i));
+    }
+    for (i = 0; i < kv_size(g->ready); ++i) {
+      kv_A(g->ready, i) = gc_forward(kv_A(g->ready, i));
+    }
+  }
+
+  for (i = 0; i < CLASS_COUNT; ++i) {
+    cls = &heap->classes[i];
+    for (page = cls->pages; page != NULL; page = page->next) {
+      for (p = page->basep; p != page->topp; p += cls->size) {
+        obj = (struct pic_object *)p;
+        if (obj->u.basic.tt != PIC_TT_INVALID && obj->u.basic.gc_mark == black) {
+          gc_update_object(pic, obj);
+        }
+      }
+    }
+  }
+  for (large = heap->large; large != NULL; large = large->next) {
+    obj = (struct pic_object *)(large + 1);
+    if (obj->u.basic.gc_mark == black) {
+      gc_update_object(pic, obj);
+    }
+  }
+}
+
+static void
+gc_compact(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+
+  gc_compact_select(pic);
+  if (kv_size(heap->compact) > 0) {
+    gc_compact_pin(pic);
+    gc_compact_evacuate(pic);
+    gc_compact_update(pic);
+  }
+  kv_size(heap->compact) = 0;
+  kv_size(heap->pinners) = 0;
+  heap->fragmented = false;
 }
 
 /* SWEEP */
@@ -555,11 +1770,11 @@ gc_finalize_object(pic_state *pic, struct pic_object *obj)
 {
   switch (obj->u.basic.tt) {
   case PIC_TT_VECTOR: {
-    pic_free(pic, obj->u.vec.data);
+    pic_gc_free(pic, obj->u.vec.data, sizeof(pic_value) * obj->u.vec.len);
     break;
   }
   case PIC_TT_BLOB: {
-    pic_free(pic, obj->u.blob.data);
+    pic_gc_free(pic, obj->u.blob.data, obj->u.blob.len);
     break;
   }
   case PIC_TT_STRING: {
@@ -571,14 +1786,27 @@ gc_finalize_object(pic_state *pic, struct pic_object *obj)
     break;
   }
   case PIC_TT_IREP: {
+#if PIC_JIT
+    pic_jit_free(pic, &obj->u.irep);
+#endif
+#if VM_PROFILE
+    if (obj->u.irep.prof != NULL) {
+      obj->u.irep.prof->irep = NULL;
+    }
+#endif
     pic_free(pic, obj->u.irep.code);
     pic_free(pic, obj->u.irep.irep);
     pic_free(pic, obj->u.irep.pool);
+    pic_free(pic, obj->u.irep.cache);
     break;
   }
   case PIC_TT_DATA: {
+    struct finalizer f;
+
     if (obj->u.data.type->dtor) {
-      obj->u.data.type->dtor(pic, obj->u.data.data);
+      f.dtor = obj->u.data.type->dtor;
+      f.data = obj->u.data.data;
+      kv_push(struct finalizer, pic->heap->finalizers, f);
     }
     break;
   }
@@ -594,10 +1822,14 @@ gc_finalize_object(pic_state *pic, struct pic_object *obj)
     kh_destroy(reg, &obj->u.reg.hash);
     break;
   }
+  case PIC_TT_PROC: {
+    if (pic_proc_func_p(&obj->u.proc)) {
+      pic_free(pic, obj->u.proc.u.f.spec);
+    }
+    break;
+  }
 
   case PIC_TT_PAIR:
-  case PIC_TT_CXT:
-  case PIC_TT_PROC:
   case PIC_TT_PORT:
   case PIC_TT_ERROR:
   case PIC_TT_ID:
@@ -619,58 +1851,173 @@ gc_finalize_object(pic_state *pic, struct pic_object *obj)
   }
 }
 
-static size_t
-gc_sweep_page(pic_state *pic, struct heap_page *page)
+static void
+gc_sweep_large(pic_state *pic)
 {
-  union header *bp, *p, *head = NULL, *tail = NULL;
-  struct pic_object *obj;
-  size_t alive = 0;
+  struct pic_heap *heap = pic->heap;
+  struct large_object *large, **link = &heap->large;
+  char black = pic->gc_black;
+
+  while ((large = *link) != NULL) {
+    if (((struct pic_object *)(large + 1))->u.basic.gc_mark == black) {
+      heap->sweep_objects[((struct pic_object *)(large + 1))->u.basic.tt]++;
+      link = &large->next;
+      continue;
+    }
+    *link = large->next;
+    gc_finalize_object(pic, (struct pic_object *)(large + 1));
+    heap->external -= large->size;
+    large_unmap(pic, large, large->size);
+  }
+}
+
+/* runs the queued destructors, outside of any collection; those left after an error run next time */
+static void
+gc_run_finalizers(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct finalizer f;
+  size_t ai;
 
-  for (bp = page->basep; ; bp = bp->s.ptr) {
-    p = bp + (bp->s.size ? bp->s.size : 1); /* first bp's size is 0, so force advnce */
-    for (; p != bp->s.ptr; p += p->s.size) {
-      if (p < page->basep || page->endp <= p) {
-        goto escape;
+  if (heap->finalizing) {
+    return;
+  }
+  heap->finalizing = true;
+
+  ai = pic_gc_arena_preserve(pic);
+  pic_try {
+    while (kv_size(heap->finalizers) > 0) {
+      f = kv_pop(heap->finalizers);
+      heap->stats.finalized++;
+      f.dtor(pic, f.data);
+      pic_gc_arena_restore(pic, ai);
+    }
+  }
+  pic_catch {
+    heap->finalizing = false;
+    pic_raise(pic, pic->err);
+  }
+  heap->finalizing = false;
+}
+
+/* sweeps the next page of cls; a page with no survivor goes to the empty list */
+static void
+gc_sweep_class_page(pic_state *pic, struct size_class *cls)
+{
+  struct pic_heap *heap = pic->heap;
+  struct class_page *page = *cls->sweep;
+  union slot *s, *freep = cls->freep;
+  size_t alive = 0;
+  char *p, black = pic->gc_black;
+
+  for (p = page->basep; p != page->topp; p += cls->size) {
+    s = (union slot *)p;
+    if (s->basic.tt != PIC_TT_INVALID) {
+      if (s->basic.gc_mark == black || s->basic.gc_mark == GC_REMEMBERED) {
+        alive += cls->size;
+        heap->sweep_objects[s->basic.tt]++;
+        continue;
       }
-      obj = (struct pic_object *)(p + 1);
-      if (obj->u.basic.gc_mark == PIC_GC_MARK) {
-        obj->u.basic.gc_mark = PIC_GC_UNMARK;
-        alive += p->s.size;
-      } else {
-        if (head == NULL) {
-          head = p;
-        }
-        if (tail != NULL) {
-          tail->s.ptr = p;
-        }
-        tail = p;
-        tail->s.ptr = NULL; /* We can safely reuse ptr field of dead object */
+      if (s->basic.gc_mark != GC_FORWARDED) {
+        gc_finalize_object(pic, (struct pic_object *)s);
       }
+      s->basic.tt = PIC_TT_INVALID;
+    }
+    s->free.next = freep;
+    freep = s;
+  }
+
+  if (alive == 0) {
+    *cls->sweep = page->next;
+    page->next = heap->empty;
+    heap->empty = page;
+    heap->nempty++;
+  } else {
+    cls->freep = freep;
+    cls->sweep = &page->next;
+    heap->sweep_live += alive;
+  }
+  if (*cls->sweep == NULL) {
+    cls->sweep = NULL;
+  }
+}
+
+/* sweeps the rest of the class pages; true if the heap has been extended */
+static bool
+gc_sweep_finish(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+  struct size_class *cls;
+  struct class_page *page;
+  size_t i, live, external, limit, used;
+  bool grown = false;
+
+  if (! heap->sweeping) {
+    return false;
+  }
+
+  for (i = 0; i < CLASS_COUNT; ++i) {
+    cls = &heap->classes[i];
+    while (cls->sweep != NULL) {
+      gc_sweep_class_page(pic, cls);
     }
   }
- escape:
+  heap->sweeping = false;
 
-  /* free! */
-  while (head != NULL) {
-    p = head;
-    head = head->s.ptr;
-    gc_finalize_object(pic, (struct pic_object *)(p + 1));
-    heap_free(pic, p + 1);
+  live = heap->sweep_live;
+
+  /* what is left of the memory outside the class pages once new allocations are put aside */
+  external = heap->external > heap->external_debt ? heap->external - heap->external_debt : 0;
+
+  if (heap->sweep_major) {
+    limit = PIC_HEAP_TARGET(live);
+    if (limit < PIC_HEAP_PAGE_SIZE) {
+      limit = PIC_HEAP_PAGE_SIZE;
+    }
+    grown = limit > heap->limit;
+    heap->limit = limit;
+    heap->old_limit = PIC_GC_MAJOR_THRESHOLD(live + external);
+
+    used = heap->size - heap->nempty * PIC_HEAP_CLASS_PAGE_SIZE;
+    heap->fragmented = PIC_GC_COMPACT > 0 && (used - live) * 100 > used * PIC_GC_COMPACT;
+  } else if (live > heap->limit - heap->limit / 4 || live + external > heap->old_limit) {
+    heap->major = true;
+  } else if (heap->allocated > (heap->size + external) * 4) {
+    heap->major = true;         /* old garbage is only reclaimed by a major collection */
   }
 
-  return alive;
+  /* which may grow by the same ratio as the heap before it is collected */
+  limit = PIC_HEAP_TARGET(external);
+  heap->external_limit = limit > external + PIC_HEAP_PAGE_SIZE ? limit - external : PIC_HEAP_PAGE_SIZE;
+
+  large_release(pic);
+
+  heap->stats.live = live + external;
+  memcpy(heap->stats.objects, heap->sweep_objects, sizeof heap->stats.objects);
+
+  /* give pages back only when well above the target, to avoid thrashing */
+  if (heap->size > heap->limit + heap->limit / 4) {
+    while (heap->size > heap->limit && heap->empty != NULL) {
+      page = heap->empty;
+      heap->empty = page->next;
+      heap->nempty--;
+      heap_page_free(pic, page, PIC_HEAP_CLASS_PAGE_SIZE);
+      heap->size -= PIC_HEAP_CLASS_PAGE_SIZE;
+    }
+  }
+  return grown;
 }
 
 static void
-gc_sweep_phase(pic_state *pic)
+gc_sweep_phase(pic_state *pic, bool major)
 {
-  struct heap_page *page;
+  struct pic_heap *heap = pic->heap;
   khiter_t it;
   khash_t(reg) *h;
   khash_t(s) *s = &pic->syms;
   pic_sym *sym;
   struct pic_object *obj;
-  size_t total = 0, inuse = 0;
+  size_t i;
 
   /* registries */
   while (pic->heap->regs != NULL) {
@@ -679,7 +2026,7 @@ gc_sweep_phase(pic_state *pic)
       if (! kh_exist(h, it))
         continue;
       obj = kh_key(h, it);
-      if (obj->u.basic.gc_mark == PIC_GC_UNMARK) {
+      if (obj->u.basic.gc_mark != pic->gc_black) {
         kh_del(reg, h, it);
       }
     }
@@ -691,54 +2038,260 @@ gc_sweep_phase(pic_state *pic)
     if (! kh_exist(s, it))
       continue;
     sym = kh_val(s, it);
-    if (sym->gc_mark == PIC_GC_UNMARK) {
+    if (sym->gc_mark != pic->gc_black) {
       kh_del(s, s, it);
     }
   }
 
-  page = pic->heap->pages;
-  while (page) {
-    inuse += gc_sweep_page(pic, page);
-    total += page->endp - page->basep;
-    page = page->next;
+  memset(heap->sweep_objects, 0, sizeof heap->sweep_objects);
+  gc_sweep_large(pic);
+
+  heap->major = false;
+
+  /* class pages are swept on demand by class_alloc, or by gc_sweep_finish */
+  for (i = 0; i < CLASS_COUNT; ++i) {
+    heap->classes[i].freep = NULL;
+    heap->classes[i].sweep = heap->classes[i].pages ? &heap->classes[i].pages : NULL;
   }
+  heap->sweep_live = 0;
+  heap->sweep_major = major;
+  heap->sweeping = true;
+}
 
-  if (PIC_PAGE_REQUEST_THRESHOLD(total) <= inuse) {
-    heap_morecore(pic);
+static void
+gc_event(pic_state *pic, enum pic_gc_event event)
+{
+  if (pic->heap->hook) {
+    pic->heap->hook(pic, event, pic->heap->hook_data);
   }
 }
 
+static void
+gc_begin_cycle(pic_state *pic)
+{
+  struct pic_heap *heap = pic->heap;
+
+  gc_sweep_finish(pic);
+  gc_event(pic, PIC_GC_BEGIN);
+  gc_mark_start(pic, true);
+  gc_mark_roots(pic);
+
+  heap->marking = true;
+  heap->major = false;
+  heap->debt = 0;
+}
+
+static bool
+gc_run(pic_state *pic, bool major)
+{
+  struct pic_heap *heap = pic->heap;
+  unsigned long start, pause;
+
+  if (! pic->gc_enable) {
+    return false;
+  }
+
+  start = GC_CLOCK();
+  if (heap->marking) {
+    major = true;               /* complete the collection in progress */
+    heap->marking = false;
+  } else {
+    if (gc_sweep_finish(pic) && ! major) {
+      heap->stats.total_pause += GC_CLOCK() - start;
+      return false;             /* the heap has been extended instead */
+    }
+    major = major || heap->major;
+
+    /* the major collection requested by a minor one is done incrementally */
+    if (! major && heap->major && PIC_GC_STEP_BUDGET > 0) {
+      gc_begin_cycle(pic);
+      heap->stats.total_pause += GC_CLOCK() - start;
+      return false;
+    }
+    gc_event(pic, PIC_GC_BEGIN);
+    gc_mark_start(pic, major);
+  }
+  gc_mark_finish(pic);
+  if (major && heap->compacting && heap->fragmented) {
+    gc_compact(pic);
+  }
+  gc_sweep_phase(pic, major);
+
+  pause = GC_CLOCK() - start;
+  heap->stats.collections++;
+  heap->stats.major_collections += major;
+  heap->stats.last_pause = pause;
+  heap->stats.total_pause += pause;
+  gc_event(pic, PIC_GC_END);
+
+  return major;
+}
+
 void
 pic_gc_run(pic_state *pic)
 {
+  pic->heap->compacting = true;
+  gc_run(pic, true);
+  pic->heap->compacting = false;
+
+  gc_sweep_finish(pic);
+  gc_run_finalizers(pic);
+}
+
+bool
+pic_gc_step(pic_state *pic, size_t budget)
+{
+  unsigned long start;
+  bool done;
+
   if (! pic->gc_enable) {
-    return;
+    return false;
+  }
+
+  start = GC_CLOCK();
+  if (! pic->heap->marking) {
+    gc_begin_cycle(pic);
+  }
+  done = gc_mark_drain(pic, budget > 0 ? budget : 1); /* every step makes progress */
+  pic->heap->stats.total_pause += GC_CLOCK() - start;
+  if (! done) {
+    return false;
+  }
+  gc_run(pic, true);
+  return true;
+}
+
+void
+pic_gc_stats(pic_state *pic, struct pic_gc_stats *stats)
+{
+  gc_sweep_finish(pic);         /* so that the numbers are those of the last collection */
+
+  *stats = pic->heap->stats;
+  stats->pages = pic->heap->size / PIC_HEAP_CLASS_PAGE_SIZE;
+}
+
+void
+pic_gc_set_hook(pic_state *pic, pic_gc_hook_t hook, void *userdata)
+{
+  pic->heap->hook = hook;
+  pic->heap->hook_data = userdata;
+}
+
+static void
+guardian_dtor(pic_state *pic, void *data)
+{
+  struct guardian *g = data;
+
+  kv_destroy(g->objects);
+  kv_destroy(g->ready);
+  pic_free(pic, g);
+}
+
+static void
+guardian_mark(pic_state *pic, void *data, void (*mark)(pic_state *, pic_value))
+{
+  struct guardian *g = data;
+  size_t i;
+
+  for (i = 0; i < kv_size(g->ready); ++i) {
+    mark(pic, pic_obj_value(kv_A(g->ready, i)));
+  }
+}
+
+static const pic_data_type guardian_type = { "guardian", guardian_dtor, guardian_mark };
+
+pic_value
+pic_make_guardian(pic_state *pic)
+{
+  struct guardian *g;
+
+  g = pic_malloc(pic, sizeof(struct guardian));
+  kv_init(g->objects);
+  kv_init(g->ready);
+  g->owner = pic_data_alloc(pic, &guardian_type, g);
+  g->next = pic->heap->guardians;
+  pic->heap->guardians = g;
+
+  return pic_obj_value(g->owner);
+}
+
+bool
+pic_guardian_p(pic_value obj)
+{
+  return pic_data_type_p(obj, &guardian_type);
+}
+
+void
+pic_guardian_add(pic_state *pic, pic_value guardian, pic_value obj)
+{
+  struct guardian *g = pic_data_ptr(guardian)->data;
+
+  if (! pic_obj_p(obj)) {
+    pic_errorf(pic, "guardian: expected heap object, but got immediate value ~s", obj);
   }
+  kv_push(struct pic_object *, g->objects, pic_obj_ptr(obj));
+}
+
+pic_value
+pic_guardian_poll(pic_state PIC_UNUSED(*pic), pic_value guardian)
+{
+  struct guardian *g = pic_data_ptr(guardian)->data;
 
-  gc_mark_phase(pic);
-  gc_sweep_phase(pic);
+  if (kv_size(g->ready) == 0) {
+    return pic_false_value();
+  }
+  return pic_obj_value(kv_pop(g->ready));
 }
 
 struct pic_object *
 pic_obj_alloc_unsafe(pic_state *pic, size_t size, enum pic_tt tt)
 {
   struct pic_object *obj;
+  bool major;
 
 #if GC_STRESS
   pic_gc_run(pic);
 #endif
 
+  if (kv_size(pic->heap->finalizers) >= PIC_GC_FINALIZE_BATCH) {
+    gc_run_finalizers(pic);
+  }
+
+  /* large objects and buffers bring a collection forward, or the end of the current one */
+  if (pic->heap->external_debt > pic->heap->external_limit) {
+    gc_run(pic, false);
+  }
+
+#if PIC_GC_STEP_BUDGET > 0
+  /* marking proceeds at twice the rate of allocation */
+  if (pic->heap->marking && ++pic->heap->debt >= (PIC_GC_STEP_BUDGET + 1) / 2) {
+    pic->heap->debt = 0;
+    pic_gc_step(pic, PIC_GC_STEP_BUDGET);
+  }
+#endif
+
+  pic->heap->allocated += size;
+  pic->heap->stats.allocated += size;
+
+  if (pic->prof != NULL) {
+    pic_prof_alloc(pic, size, tt);
+  }
+
   obj = (struct pic_object *)heap_alloc(pic, size);
-  if (obj == NULL) {
-    pic_gc_run(pic);
+  if (obj == NULL && ! pic->heap->marking) {
+    major = gc_run(pic, false);
     obj = (struct pic_object *)heap_alloc(pic, size);
-    if (obj == NULL) {
-      heap_morecore(pic);
+    if (obj == NULL && ! major && ! pic->heap->marking) {
+      gc_run(pic, true);
       obj = (struct pic_object *)heap_alloc(pic, size);
-      if (obj == NULL)
-	pic_panic(pic, "GC memory exhausted");
     }
   }
+  if (obj == NULL) {             /* or the heap grows while marking is in progress */
+    heap_morecore(pic);
+    obj = (struct pic_object *)heap_alloc(pic, size);
+    if (obj == NULL)
+      pic_panic(pic, "GC memory exhausted");
+  }
   obj->u.basic.gc_mark = PIC_GC_UNMARK;
   obj->u.basic.tt = tt;
 
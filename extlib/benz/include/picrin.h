@@ -44,7 +44,6 @@ typedef struct pic_state pic_state;
 #include "picrin/irep.h"
 #include "picrin/file.h"
 #include "picrin/read.h"
-#include "picrin/gc.h"
 
 KHASH_DECLARE(s, const char *, pic_sym *)
 
@@ -61,10 +60,10 @@ typedef struct {
   pic_code *ip;
   pic_value *fp;
   struct pic_irep *irep;
-  struct pic_context *cxt;
-  int regc;
-  pic_value *regs;
-  struct pic_context *up;
+#if VM_PROFILE
+  struct pic_vm_prof_entry *prof;
+  double start;                 /* negative unless the outermost activation */
+#endif
 } pic_callinfo;
 
 typedef void *(*pic_allocf)(void *, void *, size_t);
@@ -104,13 +103,13 @@ struct pic_state {
   pic_sym *uDEFINE_LIBRARY, *uIMPORT, *uEXPORT, *uCOND_EXPAND;
 
   pic_sym *uCONS, *uCAR, *uCDR, *uNILP, *uSYMBOLP, *uPAIRP;
-  pic_sym *uADD, *uSUB, *uMUL, *uDIV, *uEQ, *uLT, *uLE, *uGT, *uGE, *uNOT;
+  pic_sym *uADD, *uSUB, *uMUL, *uDIV, *uEQ, *uLT, *uLE, *uGT, *uGE, *uNOT, *uAPPLY;
 
   pic_value pCONS, pCAR, pCDR, pNILP, pPAIRP, pSYMBOLP, pNOT;
-  pic_value pADD, pSUB, pMUL, pDIV, pEQ, pLT, pLE, pGT, pGE;
+  pic_value pADD, pSUB, pMUL, pDIV, pEQ, pLT, pLE, pGT, pGE, pAPPLY;
 
   struct pic_box *cCONS, *cCAR, *cCDR, *cNILP, *cPAIRP, *cSYMBOLP, *cNOT;
-  struct pic_box *cADD, *cSUB, *cMUL, *cDIV, *cEQ, *cLT, *cLE, *cGT, *cGE;
+  struct pic_box *cADD, *cSUB, *cMUL, *cDIV, *cEQ, *cLT, *cLE, *cGT, *cGE, *cAPPLY;
 
   struct pic_lib *PICRIN_BASE;
   struct pic_lib *PICRIN_USER;
@@ -129,9 +128,14 @@ struct pic_state {
   pic_code iseq[2];             /* for pic_apply_trampoline */
 
   bool gc_enable;
+  char gc_black;                /* mark value of live objects */
   struct pic_heap *heap;
   struct pic_object **arena;
   size_t arena_size, arena_idx;
+  struct pic_prof *prof;        /* allocation profiler, if running */
+#if VM_PROFILE
+  struct pic_vm_prof *vmprof;
+#endif
 
   pic_value err;
 
@@ -144,10 +148,15 @@ void *pic_malloc(pic_state *, size_t);
 void *pic_realloc(pic_state *, void *, size_t);
 void *pic_calloc(pic_state *, size_t, size_t);
 void pic_free(pic_state *, void *);
+void *pic_gc_malloc(pic_state *, size_t);
+void *pic_gc_realloc(pic_state *, void *, size_t, size_t);
+void pic_gc_free(pic_state *, void *, size_t);
 
 struct pic_object *pic_obj_alloc(pic_state *, size_t, enum pic_tt);
 void pic_gc_run(pic_state *);
+bool pic_gc_step(pic_state *, size_t);
 pic_value pic_gc_protect(pic_state *, pic_value);
+void pic_gc_pin(pic_state *, const void *, size_t);
 size_t pic_gc_arena_preserve(pic_state *);
 void pic_gc_arena_restore(pic_state *, size_t);
 #define pic_void(exec)                          \
@@ -167,6 +176,9 @@ void pic_add_feature(pic_state *, const char *);
 
 struct pic_proc *pic_get_proc(pic_state *);
 int pic_get_args(pic_state *, const char *, ...);
+/* the arguments of a native made by pic_defun_spec, checked by the VM */
+#define pic_argc(pic) ((pic)->ci->argc - 1)
+#define pic_arg(pic, n) ((pic)->ci->fp[(n) + 1])
 
 bool pic_eq_p(pic_value, pic_value);
 bool pic_eqv_p(pic_value, pic_value);
@@ -184,10 +196,12 @@ void pic_load_cstr(pic_state *, const char *);
 
 void pic_define(pic_state *, const char *, pic_value);
 void pic_defun(pic_state *, const char *, pic_func_t);
+void pic_defun_spec(pic_state *, const char *, pic_func_t, const char *);
 void pic_defvar(pic_state *, const char *, pic_value, struct pic_proc *);
 /* functions suffixed with '_' do not involve automatic export */
 void pic_define_(pic_state *, const char *, pic_value);
 void pic_defun_(pic_state *, const char *, pic_func_t);
+void pic_defun_spec_(pic_state *, const char *, pic_func_t, const char *);
 void pic_defvar_(pic_state *, const char *, pic_value, struct pic_proc *);
 
 pic_value pic_ref(pic_state *, struct pic_lib *, const char *);
@@ -199,6 +213,7 @@ pic_value pic_funcall2(pic_state *pic, struct pic_lib *, const char *, pic_value
 pic_value pic_funcall3(pic_state *pic, struct pic_lib *, const char *, pic_value, pic_value, pic_value);
 
 pic_value pic_apply(pic_state *, struct pic_proc *, int, pic_value *);
+pic_value *pic_apply_argv(pic_state *, int);
 pic_value pic_apply0(pic_state *, struct pic_proc *);
 pic_value pic_apply1(pic_state *, struct pic_proc *, pic_value);
 pic_value pic_apply2(pic_state *, struct pic_proc *, pic_value, pic_value);
@@ -255,6 +270,7 @@ pic_value pic_fdisplay(pic_state *, pic_value, xFILE *);
 # define pic_fdebug(pic,obj,file) pic_fwrite(pic,obj,file)
 #endif
 
+#include "picrin/gc.h"
 #include "picrin/blob.h"
 #include "picrin/cont.h"
 #include "picrin/data.h"
@@ -265,6 +281,7 @@ pic_value pic_fdisplay(pic_state *, pic_value, xFILE *);
 #include "picrin/pair.h"
 #include "picrin/port.h"
 #include "picrin/proc.h"
+#include "picrin/prof.h"
 #include "picrin/record.h"
 #include "picrin/string.h"
 #include "picrin/symbol.h"
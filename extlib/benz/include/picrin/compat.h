@@ -76,6 +76,11 @@ typedef unsigned long uint32_t;
 #else
 # define PIC_UNREACHABLE() (assert(false))
 #endif
+#if GCC_VERSION >= 50000 || __clang__
+# define PIC_OVERFLOW_BUILTINS 1
+#else
+# define PIC_OVERFLOW_BUILTINS 0
+#endif
 #if __GNUC__
 # undef GCC_VERSION
 #endif
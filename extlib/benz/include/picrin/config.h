@@ -17,6 +17,15 @@
 /** use stdio or not */
 /* #define PIC_ENABLE_STDIO 1 */
 
+/** compile primitive calls over local variables and constants to register instructions */
+/* #define PIC_REGISTER_VM 0 */
+
+/** translate hot procedures to native code (x86-64 Linux with PIC_NAN_BOXING only) */
+/* #define PIC_JIT 0 */
+
+/** number of calls after which a procedure is translated */
+/* #define PIC_JIT_THRESHOLD 1000 */
+
 /** custom setjmp/longjmp */
 /* #define PIC_JMPBUF jmp_buf */
 /* #define PIC_SETJMP(pic, buf) setjmp(buf) */
@@ -30,9 +39,43 @@
 
 /* #define PIC_HEAP_PAGE_SIZE 10000 */
 
-/* #define PIC_PAGE_REQUEST_THRESHOLD(total) ((total) * 77 / 100) */
+/** target heap size given the bytes that survived a major collection */
+/* #define PIC_HEAP_TARGET(live) ((live) * 3 / 2) */
+
+/** obtain heap pages from mmap(2) instead of allocf, so that they can be returned to the OS */
+/* #define PIC_USE_MMAP 1 */
+
+/** drive the sampling profiler with setitimer(2) and SIGPROF */
+/* #define PIC_USE_SIGPROF 1 */
+
+/** a major collection starts when the old generation exceeds this size */
+/* #define PIC_GC_MAJOR_THRESHOLD(live) ((live) * 2) */
+
+/** work done by one step of incremental marking (0 makes major collections atomic) */
+/* #define PIC_GC_STEP_BUDGET 2048 */
+
+/** helper threads for parallel marking, needs pthreads (0 keeps the collector single-threaded) */
+/* #define PIC_GC_THREADS 0 */
+
+/** pic_gc_run moves objects out of sparse pages once this percentage of the used pages is free (0 never) */
+/* #define PIC_GC_COMPACT 0 */
+
+/** destructors of dead data objects are run in batches of this size, out of the collector */
+/* #define PIC_GC_FINALIZE_BATCH 1 */
+
+/** objects up to PIC_HEAP_CLASS_MAX bytes are allocated from size-class pages */
+/* #define PIC_HEAP_CLASS_MAX 256 */
+
+/* #define PIC_HEAP_CLASS_PAGE_SIZE (32 * 1024) */
+
+/** large objects and buffers of at least this size are mapped one by one */
+/* #define PIC_HEAP_LARGE_SIZE (1024 * 1024) */
 
-/* #define PIC_STACK_SIZE 1024 */
+/** the VM stacks start with this many slots and grow on demand */
+/* #define PIC_STACK_SIZE 256 */
+
+/** calls nesting deeper than this many slots raise a stack overflow error */
+/* #define PIC_STACK_MAX (1024 * 1024) */
 
 /* #define PIC_RESCUE_SIZE 30 */
 
@@ -55,6 +98,9 @@
 /* #define GC_DEBUG 1 */
 /* #define GC_DEBUG_DETAIL 1 */
 
+/** count the instructions and time the procedures run by the VM, see (picrin profile) */
+/* #define VM_PROFILE 1 */
+
 #ifndef PIC_DIRECT_THREADED_VM
 # if (defined(__GNUC__) || defined(__clang__)) && __STRICT_ANSI__ != 1
 #  define PIC_DIRECT_THREADED_VM 1
@@ -77,6 +123,26 @@
 # endif
 #endif
 
+#ifndef PIC_REGISTER_VM
+# define PIC_REGISTER_VM 0
+#endif
+
+#ifndef PIC_JIT
+# define PIC_JIT 0
+#endif
+
+#if PIC_JIT && ! (PIC_NAN_BOXING && __x86_64__ && __linux__)
+# error PIC_JIT requires PIC_NAN_BOXING on x86-64 Linux
+#endif
+
+#if PIC_JIT && VM_PROFILE
+# error VM_PROFILE counts interpreted instructions and cannot be used with PIC_JIT
+#endif
+
+#ifndef PIC_JIT_THRESHOLD
+# define PIC_JIT_THRESHOLD 1000
+#endif
+
 #ifndef PIC_ENABLE_LIBC
 # define PIC_ENABLE_LIBC 1
 #endif
@@ -112,12 +178,64 @@
 # define PIC_HEAP_PAGE_SIZE (4 * 1024 * 1024)
 #endif
 
-#ifndef PIC_PAGE_REQUEST_THRESHOLD
-# define PIC_PAGE_REQUEST_THRESHOLD(total) ((total) * 77 / 100)
+#ifndef PIC_HEAP_TARGET
+# define PIC_HEAP_TARGET(live) ((live) * 3 / 2)
+#endif
+
+#ifndef PIC_USE_MMAP
+# if PIC_ENABLE_LIBC && defined(__linux__)
+#  define PIC_USE_MMAP 1
+# else
+#  define PIC_USE_MMAP 0
+# endif
+#endif
+
+#ifndef PIC_USE_SIGPROF
+# if PIC_ENABLE_LIBC && (defined(__unix__) || defined(__APPLE__))
+#  define PIC_USE_SIGPROF 1
+# else
+#  define PIC_USE_SIGPROF 0
+# endif
+#endif
+
+#ifndef PIC_GC_MAJOR_THRESHOLD
+# define PIC_GC_MAJOR_THRESHOLD(live) ((live) * 2)
+#endif
+
+#ifndef PIC_GC_STEP_BUDGET
+# define PIC_GC_STEP_BUDGET 2048
+#endif
+
+#ifndef PIC_GC_THREADS
+# define PIC_GC_THREADS 0
+#endif
+
+#ifndef PIC_GC_COMPACT
+# define PIC_GC_COMPACT 0
+#endif
+
+#ifndef PIC_GC_FINALIZE_BATCH
+# define PIC_GC_FINALIZE_BATCH 1
+#endif
+
+#ifndef PIC_HEAP_CLASS_MAX
+# define PIC_HEAP_CLASS_MAX 256
+#endif
+
+#ifndef PIC_HEAP_CLASS_PAGE_SIZE
+# define PIC_HEAP_CLASS_PAGE_SIZE (32 * 1024)
+#endif
+
+#ifndef PIC_HEAP_LARGE_SIZE
+# define PIC_HEAP_LARGE_SIZE (1024 * 1024)
 #endif
 
 #ifndef PIC_STACK_SIZE
-# define PIC_STACK_SIZE 2048
+# define PIC_STACK_SIZE 256
+#endif
+
+#ifndef PIC_STACK_MAX
+# define PIC_STACK_MAX (1024 * 1024)
 #endif
 
 #ifndef PIC_RESCUE_SIZE
@@ -17,6 +17,46 @@ struct pic_heap;
 struct pic_heap *pic_heap_open(pic_state *);
 void pic_heap_close(pic_state *, struct pic_heap *);
 
+void pic_gc_remember(pic_state *, void *);
+
+struct pic_gc_stats {
+  size_t collections;           /* completed collections, minor or major */
+  size_t major_collections;
+  unsigned long total_pause;    /* microseconds spent in the collector, incremental steps included */
+  unsigned long last_pause;     /* microseconds taken by the last collection to finish */
+  size_t allocated;             /* bytes of objects and buffers allocated so far */
+  size_t live;                  /* bytes that survived the last collection */
+  size_t pages;                 /* class pages held by the heap */
+  size_t finalized;             /* destructors run so far */
+  size_t objects[PIC_TT_CP + 1]; /* objects that survived the last collection, by type */
+};
+
+void pic_gc_stats(pic_state *, struct pic_gc_stats *);
+
+enum pic_gc_event {
+  PIC_GC_BEGIN,
+  PIC_GC_END
+};
+
+/* called from within the collector; it must neither allocate nor run scheme code */
+typedef void (*pic_gc_hook_t)(pic_state *, enum pic_gc_event, void *);
+
+void pic_gc_set_hook(pic_state *, pic_gc_hook_t, void *);
+
+pic_value pic_make_guardian(pic_state *);
+bool pic_guardian_p(pic_value);
+void pic_guardian_add(pic_state *, pic_value, pic_value);
+pic_value pic_guardian_poll(pic_state *, pic_value); /* an unreachable object registered to it, or #f */
+
+/* must be called before a reference to v is stored into obj */
+PIC_INLINE void
+pic_write_barrier(pic_state *pic, void *obj, pic_value v)
+{
+  if (((struct pic_basic *)obj)->gc_mark == pic->gc_black && pic_obj_p(v) && ((struct pic_basic *)pic_ptr(v))->gc_mark != pic->gc_black) {
+    pic_gc_remember(pic, obj);
+  }
+}
+
 #if defined(__cplusplus)
 }
 #endif
@@ -15,20 +15,34 @@ typedef struct {
     int i;
     char c;
     struct {
-      int depth;
-      int idx;
-    } r;
+      int a;
+      int b;
+    } o;
+    struct {
+      int argc;                 /* same as i */
+      int site;                 /* index into the inline caches, or -1 */
+    } call;
   } u;
 } pic_code;
 
 struct pic_irep {
   PIC_OBJECT_HEADER
   pic_code *code;
-  int argc, localc, capturec;
+  int argc, localc, freec;
+  int stackc;                   /* bound of the slots a frame uses above its arguments */
   bool varg;
+  bool lazyrest;                /* the rest list is made on demand */
   struct pic_irep **irep;
   pic_value *pool;
-  size_t ilen, plen;
+  struct pic_irep **cache;      /* inline caches of the call sites */
+  size_t clen, ilen, plen, cachelen;
+#if PIC_JIT
+  int calls;
+  struct pic_jit *jit;
+#endif
+#if VM_PROFILE
+  struct pic_vm_prof_entry *prof;
+#endif
 };
 
 pic_sym *pic_resolve(pic_state *, pic_value, struct pic_env *);
@@ -37,6 +51,20 @@ pic_value pic_analyze(pic_state *, pic_value);
 struct pic_irep *pic_codegen(pic_state *, pic_value);
 struct pic_proc *pic_compile(pic_state *, pic_value, struct pic_env *);
 
+void pic_vm_grow_stack(pic_state *, size_t, pic_value **);
+void pic_vm_reclaim_headroom(pic_state *);
+pic_value pic_vm_apply_spread(pic_state *, struct pic_proc *, int, pic_value *);
+
+#if PIC_JIT
+typedef int (*pic_jit_helper)(pic_state *, pic_code *);
+
+pic_jit_helper pic_vm_jit_helper(int);
+
+void pic_jit_compile(pic_state *, struct pic_irep *);
+void pic_jit_enter(pic_state *, struct pic_irep *, pic_code *);
+void pic_jit_free(pic_state *, struct pic_irep *);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
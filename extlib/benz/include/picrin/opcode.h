@@ -24,7 +24,10 @@ enum pic_opcode {
   OP_LREF,
   OP_LSET,
   OP_CREF,
-  OP_CSET,
+  /* assigned variables captured by closures live in boxes */
+  OP_BOX,
+  OP_UNBOX,
+  OP_SETBOX,
   OP_JMP,
   OP_JMPIF,
   OP_NOT,
@@ -47,6 +50,35 @@ enum pic_opcode {
   OP_LE,
   OP_GT,
   OP_GE,
+  /* superinstructions, see codegen_peephole */
+  OP_LREFCAR,
+  OP_LREFCDR,
+  OP_LREFNILPJMPIF,
+  OP_LREFADDI,
+  OP_LREFSUBI,
+  /* rest lists made on demand, see codegen_rest */
+  OP_RESTNILP,
+  OP_RESTPAIRP,
+  OP_RESTCAR,
+  OP_LREFREST,
+  OP_APPLYREST,
+  /* register instructions, see codegen_register_call */
+  OP_RCONS,
+  OP_RCAR,
+  OP_RCDR,
+  OP_RNILP,
+  OP_RSYMBOLP,
+  OP_RPAIRP,
+  OP_RNOT,
+  OP_RADD,
+  OP_RSUB,
+  OP_RMUL,
+  OP_RDIV,
+  OP_REQ,
+  OP_RLT,
+  OP_RLE,
+  OP_RGT,
+  OP_RGE,
   OP_STOP
 };
 
@@ -101,10 +133,16 @@ pic_dump_code(pic_code c)
     printf("OP_LSET\t%d\n", c.u.i);
     break;
   case OP_CREF:
-    printf("OP_CREF\t%d\t%d\n", c.u.r.depth, c.u.r.idx);
+    printf("OP_CREF\t%d\n", c.u.i);
     break;
-  case OP_CSET:
-    printf("OP_CSET\t%d\t%d\n", c.u.r.depth, c.u.r.idx);
+  case OP_BOX:
+    printf("OP_BOX\t%d\n", c.u.i);
+    break;
+  case OP_UNBOX:
+    puts("OP_UNBOX");
+    break;
+  case OP_SETBOX:
+    puts("OP_SETBOX");
     break;
   case OP_JMP:
     printf("OP_JMP\t%x\n", c.u.i);
@@ -172,6 +210,84 @@ pic_dump_code(pic_code c)
   case OP_GE:
     puts("OP_GE");
     break;
+  case OP_LREFCAR:
+    printf("OP_LREFCAR\t%d\n", c.u.i);
+    break;
+  case OP_LREFCDR:
+    printf("OP_LREFCDR\t%d\n", c.u.i);
+    break;
+  case OP_LREFNILPJMPIF:
+    printf("OP_LREFNILPJMPIF\t%d\n", c.u.i);
+    break;
+  case OP_LREFADDI:
+    printf("OP_LREFADDI\t%d\n", c.u.i);
+    break;
+  case OP_LREFSUBI:
+    printf("OP_LREFSUBI\t%d\n", c.u.i);
+    break;
+  case OP_RESTNILP:
+    printf("OP_RESTNILP\t%d\n", c.u.i);
+    break;
+  case OP_RESTPAIRP:
+    printf("OP_RESTPAIRP\t%d\n", c.u.i);
+    break;
+  case OP_RESTCAR:
+    printf("OP_RESTCAR\t%d\n", c.u.i);
+    break;
+  case OP_LREFREST:
+    printf("OP_LREFREST\t%d\n", c.u.i);
+    break;
+  case OP_APPLYREST:
+    printf("OP_APPLYREST\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RCONS:
+    printf("OP_RCONS\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RCAR:
+    printf("OP_RCAR\t%d\n", c.u.o.a);
+    break;
+  case OP_RCDR:
+    printf("OP_RCDR\t%d\n", c.u.o.a);
+    break;
+  case OP_RNILP:
+    printf("OP_RNILP\t%d\n", c.u.o.a);
+    break;
+  case OP_RSYMBOLP:
+    printf("OP_RSYMBOLP\t%d\n", c.u.o.a);
+    break;
+  case OP_RPAIRP:
+    printf("OP_RPAIRP\t%d\n", c.u.o.a);
+    break;
+  case OP_RNOT:
+    printf("OP_RNOT\t%d\n", c.u.o.a);
+    break;
+  case OP_RADD:
+    printf("OP_RADD\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RSUB:
+    printf("OP_RSUB\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RMUL:
+    printf("OP_RMUL\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RDIV:
+    printf("OP_RDIV\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_REQ:
+    printf("OP_REQ\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RLT:
+    printf("OP_RLT\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RLE:
+    printf("OP_RLE\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RGT:
+    printf("OP_RGT\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
+  case OP_RGE:
+    printf("OP_RGE\t%d\t%d\n", c.u.o.a, c.u.o.b);
+    break;
   case OP_STOP:
     puts("OP_STOP");
     break;
@@ -184,7 +300,7 @@ pic_dump_irep(struct pic_irep *irep)
   unsigned i;
 
   printf("## irep %p\n", (void *)irep);
-  printf("[clen = %zd, argc = %d, localc = %d, capturec = %d]\n", irep->clen, irep->argc, irep->localc, irep->capturec);
+  printf("[clen = %zd, argc = %d, localc = %d, freec = %d]\n", irep->clen, irep->argc, irep->localc, irep->freec);
   for (i = 0; i < irep->clen; ++i) {
     printf("%02x: ", i);
     pic_dump_code(irep->code[i]);
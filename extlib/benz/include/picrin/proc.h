@@ -9,12 +9,14 @@
 extern "C" {
 #endif
 
-struct pic_context {
-  PIC_OBJECT_HEADER
-  pic_value *regs;
-  int regc;
-  struct pic_context *up;
-  pic_value storage[1];
+/**
+ * The arguments a native takes, compiled from a pic_get_args format by
+ * pic_make_proc_spec. The VM checks them before the call.
+ */
+struct pic_argspec {
+  int req, opt;                 /* required and optional argument counts */
+  bool rest;
+  char type[1];                 /* the specifier of each of the req + opt */
 };
 
 struct pic_proc {
@@ -27,12 +29,13 @@ struct pic_proc {
     struct {
       pic_func_t func;
       struct pic_dict *env;
+      struct pic_argspec *spec;
     } f;
     struct {
       struct pic_irep *irep;
-      struct pic_context *cxt;
     } i;
   } u;
+  pic_value fv[1];              /* free variables, irep->freec of them */
 };
 
 #define pic_proc_func_p(proc) ((proc)->tag == PIC_PROC_TAG_FUNC)
@@ -41,11 +44,9 @@ struct pic_proc {
 #define pic_proc_p(o) (pic_type(o) == PIC_TT_PROC)
 #define pic_proc_ptr(o) ((struct pic_proc *)pic_ptr(o))
 
-#define pic_context_p(o) (pic_type(o) == PIC_TT_CXT)
-#define pic_context_ptr(o) ((struct pic_context *)pic_ptr(o))
-
 struct pic_proc *pic_make_proc(pic_state *, pic_func_t);
-struct pic_proc *pic_make_proc_irep(pic_state *, struct pic_irep *, struct pic_context *);
+struct pic_proc *pic_make_proc_spec(pic_state *, pic_func_t, const char *);
+struct pic_proc *pic_make_proc_irep(pic_state *, struct pic_irep *, pic_value *);
 
 struct pic_dict *pic_proc_env(pic_state *, struct pic_proc *);
 bool pic_proc_env_has(pic_state *, struct pic_proc *, const char *);
@@ -0,0 +1,86 @@
+/**
+ * See Copyright Notice in picrin.h
+ */
+
+#ifndef PICRIN_PROF_H
+#define PICRIN_PROF_H
+
+#if PIC_USE_SIGPROF
+# include <signal.h>
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* call tree of the sampled allocations */
+struct pic_prof_node {
+  struct pic_object *frame;     /* irep or native procedure; NULL for the leaves */
+  enum pic_tt tt;               /* type of the objects allocated, for the leaves */
+  size_t samples;
+  struct pic_prof_node *child, *next;
+};
+
+struct pic_prof {
+  size_t interval;              /* bytes allocated between two samples, or 0 when sampling time */
+  size_t left;                  /* bytes to be allocated until the next sample */
+  struct pic_prof_node root;
+  kvec_t(struct pic_object *) frames; /* kept alive until the profiler stops */
+};
+
+void pic_prof_start(pic_state *, size_t);
+void pic_prof_start_timer(pic_state *, int);
+void pic_prof_stop(pic_state *);
+void pic_prof_report(pic_state *, xFILE *);
+
+void pic_prof_alloc(pic_state *, size_t, enum pic_tt);
+
+/* timer ticks not yet sampled, counted by the signal handler */
+#if PIC_USE_SIGPROF
+typedef sig_atomic_t pic_prof_ticks_t;
+#else
+typedef int pic_prof_ticks_t;
+#endif
+
+extern volatile pic_prof_ticks_t pic_prof_ticks;
+
+void pic_prof_tick(pic_state *);
+
+#if VM_PROFILE
+
+/* counters of one procedure, run as bytecode or natively */
+struct pic_vm_prof_entry {
+  struct pic_irep *irep;        /* NULL for natives, or once collected */
+  pic_func_t func;
+  size_t calls, insns;
+  double self, total;           /* seconds */
+  int active;                   /* activations on the stack */
+  pic_sym *name;                /* scratch for the report */
+  struct pic_vm_prof_entry *next;
+};
+
+KHASH_DECLARE(vmprof, pic_func_t, struct pic_vm_prof_entry *)
+
+struct pic_vm_prof {
+  struct pic_vm_prof_entry *entries;
+  khash_t(vmprof) natives;
+  size_t *ops;                  /* executions per opcode */
+  double last;                  /* when time was last charged to a frame */
+};
+
+void pic_vm_prof_init(pic_state *);
+void pic_vm_prof_close(pic_state *);
+void pic_vm_prof_enter(pic_state *, pic_callinfo *, struct pic_proc *);
+void pic_vm_prof_leave(pic_state *, pic_callinfo *);
+void pic_vm_prof_unwind(pic_state *, pic_callinfo *);
+void pic_vm_prof_rewind(pic_state *);
+void pic_vm_prof_reset(pic_state *);
+void pic_vm_prof_report(pic_state *, xFILE *);
+
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif
@@ -74,7 +74,7 @@ typedef unsigned long pic_value;
 
 #define pic_ptr(v) ((void *)(v))
 #define pic_init_value(v,vtype) do {            \
-    v = (vtype << 3) + 7;                       \
+    v = ((vtype) << 3) + 7;                     \
   } while (0)
 
 PIC_INLINE enum pic_vtype
@@ -108,6 +108,9 @@ pic_char(pic_value v)
   return v >> 3;
 }
 
+/* a word has no room for flonums: inexact numbers are truncated to fixnums */
+#define pic_float(v) ((double)pic_int(v))
+
 #else
 
 typedef struct {
@@ -157,7 +160,6 @@ enum pic_tt {
   PIC_TT_REG,
   PIC_TT_RECORD,
   PIC_TT_BOX,
-  PIC_TT_CXT,
   PIC_TT_IREP,
   PIC_TT_CP
 };
@@ -297,8 +299,6 @@ pic_type_repr(enum pic_tt tt)
     return "error";
   case PIC_TT_ID:
     return "id";
-  case PIC_TT_CXT:
-    return "cxt";
   case PIC_TT_PROC:
     return "proc";
   case PIC_TT_ENV:
@@ -418,7 +418,16 @@ pic_obj_value(void *ptr)
 PIC_INLINE pic_value
 pic_int_value(int i)
 {
-  return (i << 2) + 1;
+  return ((pic_value)(long)i << 2) + 1;
+}
+
+PIC_INLINE pic_value
+pic_float_value(double f)
+{
+  if (f != f) {
+    return pic_int_value(0);
+  }
+  return pic_int_value(f <= INT_MIN ? INT_MIN : f >= INT_MAX ? INT_MAX : (int)f);
 }
 
 PIC_INLINE pic_value
@@ -543,17 +552,91 @@ pic_eqv_p(pic_value x, pic_value y)
 
 #endif
 
-#define pic_define_aop(name, op, guard)                                 \
+/**
+ * The pic_int_* helpers store the result of an int operation in *r and
+ * return false when it does not fit in an int (or, for division, is not
+ * an integer), in which case the caller redoes it in floating point.
+ */
+
+PIC_INLINE bool
+pic_int_add(int a, int b, int *r)
+{
+#if PIC_OVERFLOW_BUILTINS
+  return ! __builtin_add_overflow(a, b, r);
+#else
+  if ((b > 0 && a > INT_MAX - b) || (b < 0 && a < INT_MIN - b))
+    return false;
+  *r = a + b;
+  return true;
+#endif
+}
+
+PIC_INLINE bool
+pic_int_sub(int a, int b, int *r)
+{
+#if PIC_OVERFLOW_BUILTINS
+  return ! __builtin_sub_overflow(a, b, r);
+#else
+  if ((b < 0 && a > INT_MAX + b) || (b > 0 && a < INT_MIN + b))
+    return false;
+  *r = a - b;
+  return true;
+#endif
+}
+
+PIC_INLINE bool
+pic_int_mul(int a, int b, int *r)
+{
+#if PIC_OVERFLOW_BUILTINS
+  return ! __builtin_mul_overflow(a, b, r);
+#else
+  if (a == 0 || b == 0) {
+    *r = 0;
+    return true;
+  }
+  if (a > 0
+      ? (b > 0 ? a > INT_MAX / b : b < INT_MIN / a)
+      : (b > 0 ? a < INT_MIN / b : a < INT_MAX / b))
+    return false;
+  *r = a * b;
+  return true;
+#endif
+}
+
+PIC_INLINE bool
+pic_int_div(int a, int b, int *r)
+{
+  if (b == 0 || (a == INT_MIN && b == -1) || a % b != 0)
+    return false;
+  *r = a / b;
+  return true;
+}
+
+#if PIC_WORD_BOXING
+/* no flonum to fall back to: truncate, unless it does not fit at all */
+# define pic_aop_inexact(name, a, op, b) do {                            \
+    double f = (double)pic_int(a) op (double)pic_int(b);                \
+    if (f < INT_MIN || f > INT_MAX) {                                   \
+      pic_errorf(pic, #name ": fixnum overflow");                       \
+    }                                                                   \
+    return pic_float_value(f);                                          \
+  } while (0)
+#else
+# define pic_aop_inexact(name, a, op, b)                                 \
+  return pic_float_value((double)pic_int(a) op (double)pic_int(b))
+#endif
+
+#define pic_define_aop(name, op, iop)                                   \
   PIC_INLINE pic_value                                                  \
   name(pic_state *pic, pic_value a, pic_value b)                        \
   {                                                                     \
     PIC_NORETURN void pic_errorf(pic_state *, const char *, ...);       \
-    double f;                                                           \
+    int i;                                                              \
     if (pic_int_p(a) && pic_int_p(b)) {                                 \
-      f = (double)pic_int(a) op (double)pic_int(b);                     \
-      return (INT_MIN <= f && f <= INT_MAX && guard)                    \
-        ? pic_int_value((int)f)                                         \
-        : pic_float_value(f);                                           \
+      if (iop(pic_int(a), pic_int(b), &i)) {                            \
+        return pic_int_value(i);                                        \
+      }                                                                 \
+      pic_aop_inexact(name, a, op, b);                                  \
     } else if (pic_float_p(a) && pic_float_p(b)) {                      \
       return pic_float_value(pic_float(a) op pic_float(b));             \
     } else if (pic_int_p(a) && pic_float_p(b)) {                        \
@@ -566,10 +649,10 @@ pic_eqv_p(pic_value x, pic_value y)
     PIC_UNREACHABLE();                                                  \
   }
 
-pic_define_aop(pic_add, +, true)
-pic_define_aop(pic_sub, -, true)
-pic_define_aop(pic_mul, *, true)
-pic_define_aop(pic_div, /, f == (int)f)
+pic_define_aop(pic_add, +, pic_int_add)
+pic_define_aop(pic_sub, -, pic_int_sub)
+pic_define_aop(pic_mul, *, pic_int_mul)
+pic_define_aop(pic_div, /, pic_int_div)
 
 #define pic_define_cmp(name, op)                                        \
   PIC_INLINE bool                                                       \
@@ -0,0 +1,635 @@
+/**
+ * See Copyright Notice in picrin.h
+ */
+
+#include "picrin.h"
+#include "picrin/opcode.h"
+
+#if PIC_JIT
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/**
+ * A baseline JIT for x86-64 Linux. Once a procedure has been called
+ * PIC_JIT_THRESHOLD times its bytecode is translated instruction by
+ * instruction into native code by stitching fixed machine code templates.
+ * Pushes, variable references, branches, fixnum arithmetic and the list
+ * superinstructions have inline fast paths; everything else, and every
+ * slow path, calls the helper the VM exports for that instruction.
+ *
+ * Native code never calls or returns. OP_CALL, OP_TAILCALL, OP_RET and
+ * any instruction a helper refuses store the address of the instruction
+ * in pic->ip and leave to the interpreter, which runs it and enters native
+ * code again when the callee starts or returns. Frames, continuations and
+ * errors thus stay the business of the interpreter, and native code holds
+ * no pointer into the heap (which may be compacted) but the bytecode and
+ * the constant pool of the irep, which are malloc'd.
+ *
+ * The translated code keeps pic_state in %rbx, the only register that
+ * lives across the templates.
+ */
+
+struct pic_jit {
+  unsigned char *base;
+  size_t size;
+  size_t *offsets;              /* offset of the template for each instruction */
+};
+
+typedef struct {
+  unsigned char *data;
+  size_t len, capa;
+  struct jit_patch {
+    size_t at;                  /* position of a rel32 */
+    size_t target;              /* instruction it jumps to */
+  } *patches;
+  size_t plen, pcapa;
+} jit_buffer;
+
+#define OFF_SP ((unsigned)offsetof(pic_state, sp))
+#define OFF_IP ((unsigned)offsetof(pic_state, ip))
+#define OFF_CI ((unsigned)offsetof(pic_state, ci))
+#define OFF_FP ((unsigned)offsetof(pic_callinfo, fp))
+
+static void
+emit_byte(pic_state *pic, jit_buffer *buf, unsigned char b)
+{
+  if (buf->len >= buf->capa) {
+    buf->capa *= 2;
+    buf->data = pic_realloc(pic, buf->data, buf->capa);
+  }
+  buf->data[buf->len++] = b;
+}
+
+static void
+emit_bytes(pic_state *pic, jit_buffer *buf, const char *bytes, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    emit_byte(pic, buf, (unsigned char)bytes[i]);
+  }
+}
+
+static void
+emit_u32(pic_state *pic, jit_buffer *buf, uint32_t u)
+{
+  int i;
+
+  for (i = 0; i < 4; ++i) {
+    emit_byte(pic, buf, (unsigned char)(u >> (i * 8)));
+  }
+}
+
+static void
+emit_u64(pic_state *pic, jit_buffer *buf, uint64_t u)
+{
+  int i;
+
+  for (i = 0; i < 8; ++i) {
+    emit_byte(pic, buf, (unsigned char)(u >> (i * 8)));
+  }
+}
+
+static void
+emit_ptr(pic_state *pic, jit_buffer *buf, const void *ptr)
+{
+  emit_u64(pic, buf, (uint64_t)(uintptr_t)ptr);
+}
+
+/* rel32 to the template of instruction target, patched once all are laid out */
+static void
+emit_rel32(pic_state *pic, jit_buffer *buf, size_t target)
+{
+  if (buf->plen >= buf->pcapa) {
+    buf->pcapa *= 2;
+    buf->patches = pic_realloc(pic, buf->patches, sizeof(struct jit_patch) * buf->pcapa);
+  }
+  buf->patches[buf->plen].at = buf->len;
+  buf->patches[buf->plen].target = target;
+  buf->plen++;
+  emit_u32(pic, buf, 0);
+}
+
+/** mov rax, imm64 (&code[k]); mov [rbx+ip], rax; pop rbx; ret */
+#define EXIT_SIZE 19
+
+static void
+emit_exit(pic_state *pic, jit_buffer *buf, pic_code *ip)
+{
+  emit_bytes(pic, buf, "\x48\xb8", 2);
+  emit_ptr(pic, buf, ip);
+  emit_bytes(pic, buf, "\x48\x89\x83", 3);
+  emit_u32(pic, buf, OFF_IP);
+  emit_bytes(pic, buf, "\x5b\xc3", 2);
+}
+
+/** mov rdi, rbx; mov rsi, imm64 (&code[k]); mov rax, imm64 (helper); call rax */
+#define CALL_SIZE 25
+
+static void
+emit_call(pic_state *pic, jit_buffer *buf, pic_jit_helper helper, pic_code *ip)
+{
+  emit_bytes(pic, buf, "\x48\x89\xdf\x48\xbe", 5);
+  emit_ptr(pic, buf, ip);
+  emit_bytes(pic, buf, "\x48\xb8", 2);
+  emit_ptr(pic, buf, (const void *)(uintptr_t)helper);
+  emit_bytes(pic, buf, "\xff\xd0", 2);
+}
+
+/** test eax, eax; jz over the exit */
+static void
+emit_exit_unless_zero(pic_state *pic, jit_buffer *buf, pic_code *ip)
+{
+  emit_bytes(pic, buf, "\x85\xc0\x74", 3);
+  emit_byte(pic, buf, EXIT_SIZE);
+  emit_exit(pic, buf, ip);
+}
+
+/** mov rax, [rbx+sp]; mov rcx, imm64; mov [rax], rcx; add qword [rbx+sp], 8 */
+static void
+emit_push(pic_state *pic, jit_buffer *buf, pic_value v)
+{
+  emit_bytes(pic, buf, "\x48\x8b\x83", 3);
+  emit_u32(pic, buf, OFF_SP);
+  emit_bytes(pic, buf, "\x48\xb9", 2);
+  emit_u64(pic, buf, v);
+  emit_bytes(pic, buf, "\x48\x89\x08\x48\x83\x83", 6);
+  emit_u32(pic, buf, OFF_SP);
+  emit_byte(pic, buf, 0x08);
+}
+
+/** pop into rax and jump to target unless it is #f */
+static void
+emit_jmpif(pic_state *pic, jit_buffer *buf, size_t target)
+{
+  emit_bytes(pic, buf, "\x48\x8b\x83", 3); /* mov rax, [rbx+sp] */
+  emit_u32(pic, buf, OFF_SP);
+  emit_bytes(pic, buf, "\x48\x83\xe8\x08\x48\x89\x83", 7); /* sub rax, 8; mov [rbx+sp], rax */
+  emit_u32(pic, buf, OFF_SP);
+  emit_bytes(pic, buf, "\x48\x8b\x00\x48\xb9", 5); /* mov rax, [rax]; mov rcx, #f */
+  emit_u64(pic, buf, pic_false_value());
+  emit_bytes(pic, buf, "\x48\x39\xc8\x0f\x85", 5); /* cmp rax, rcx; jne */
+  emit_rel32(pic, buf, target);
+}
+
+static void
+emit_jmp(pic_state *pic, jit_buffer *buf, size_t target)
+{
+  emit_byte(pic, buf, 0xe9);
+  emit_rel32(pic, buf, target);
+}
+
+/**
+ * Fast paths jump forward to a label within the template, mostly to the
+ * slow path calling the helper. A label collects the rel32 referring to it
+ * until it is bound.
+ */
+typedef struct {
+  size_t at[8];
+  int n;
+} jit_label;
+
+static void
+emit_fwd(pic_state *pic, jit_buffer *buf, const char *op, size_t n, jit_label *label)
+{
+  emit_bytes(pic, buf, op, n);
+  assert(label->n < 8);
+  label->at[label->n++] = buf->len;
+  emit_u32(pic, buf, 0);
+}
+
+static void
+bind_label(jit_buffer *buf, jit_label *label)
+{
+  int32_t rel;
+  int i;
+
+  for (i = 0; i < label->n; ++i) {
+    rel = (int32_t)(buf->len - (label->at[i] + 4));
+    memcpy(buf->data + label->at[i], &rel, 4);
+  }
+}
+
+#define JNE "\x0f\x85", 2
+#define JE "\x0f\x84", 2
+#define JO "\x0f\x80", 2
+#define JMP "\xe9", 1
+
+/** go slow unless pic->p##name is still bound to the global */
+static void
+emit_check_prim(pic_state *pic, jit_buffer *buf, unsigned off_p, unsigned off_c, jit_label *slow)
+{
+  emit_bytes(pic, buf, "\x48\x8b\x83", 3); /* mov rax, [rbx+c] */
+  emit_u32(pic, buf, off_c);
+  emit_bytes(pic, buf, "\x48\x8b\x80", 3); /* mov rax, [rax+value] */
+  emit_u32(pic, buf, (unsigned)offsetof(struct pic_box, value));
+  emit_bytes(pic, buf, "\x48\x3b\x83", 3); /* cmp rax, [rbx+p] */
+  emit_u32(pic, buf, off_p);
+  emit_fwd(pic, buf, JNE, slow);
+}
+
+#define CHECK_PRIM(pic, buf, name, slow)                                \
+  emit_check_prim(pic, buf, (unsigned)offsetof(pic_state, p##name), (unsigned)offsetof(pic_state, c##name), slow)
+
+/** local i into rax */
+static void
+emit_load_lref(pic_state *pic, jit_buffer *buf, int i)
+{
+  emit_bytes(pic, buf, "\x48\x8b\x83", 3); /* mov rax, [rbx+ci] */
+  emit_u32(pic, buf, OFF_CI);
+  emit_bytes(pic, buf, "\x48\x8b\x80", 3); /* mov rax, [rax+fp] */
+  emit_u32(pic, buf, OFF_FP);
+  emit_bytes(pic, buf, "\x48\x8b\x80", 3); /* mov rax, [rax+i*8] */
+  emit_u32(pic, buf, (uint32_t)i * sizeof(pic_value));
+}
+
+/** go slow unless rax (or rdx) holds a fixnum */
+static void
+emit_check_int(pic_state *pic, jit_buffer *buf, bool rdx, jit_label *slow)
+{
+  emit_bytes(pic, buf, rdx ? "\x48\x89\xd6" : "\x48\x89\xc6", 3); /* mov rsi, rax/rdx */
+  emit_bytes(pic, buf, "\x48\xc1\xee\x20\x81\xfe", 6); /* shr rsi, 32; cmp esi, tag */
+  emit_u32(pic, buf, (uint32_t)(pic_int_value(0) >> 32));
+  emit_fwd(pic, buf, JNE, slow);
+}
+
+/** box eax as a fixnum in rax */
+static void
+emit_box_int(pic_state *pic, jit_buffer *buf)
+{
+  emit_bytes(pic, buf, "\x89\xc0\x48\xbe", 4); /* mov eax, eax; mov rsi, tag */
+  emit_u64(pic, buf, pic_int_value(0));
+  emit_bytes(pic, buf, "\x48\x09\xf0", 3); /* or rax, rsi */
+}
+
+static void
+emit_push_rax(pic_state *pic, jit_buffer *buf)
+{
+  emit_bytes(pic, buf, "\x48\x8b\x8b", 3); /* mov rcx, [rbx+sp] */
+  emit_u32(pic, buf, OFF_SP);
+  emit_bytes(pic, buf, "\x48\x89\x01\x48\x83\x83", 6); /* mov [rcx], rax; add qword [rbx+sp], 8 */
+  emit_u32(pic, buf, OFF_SP);
+  emit_byte(pic, buf, 0x08);
+}
+
+/** free variable i of the running closure, found at fp[0] */
+static void
+emit_cref(pic_state *pic, jit_buffer *buf, int i)
+{
+  emit_load_lref(pic, buf, 0);
+  emit_bytes(pic, buf, "\x48\xbe", 2); /* mov rsi, mask */
+  emit_u64(pic, buf, 0xfffffffffffful);
+  emit_bytes(pic, buf, "\x48\x21\xf0\x48\x8b\x80", 6); /* and rax, rsi; mov rax, [rax+fv+i*8] */
+  emit_u32(pic, buf, (uint32_t)(offsetof(struct pic_proc, fv) + i * sizeof(pic_value)));
+  emit_push_rax(pic, buf);
+}
+
+static void
+emit_unbox(pic_state *pic, jit_buffer *buf)
+{
+  emit_bytes(pic, buf, "\x48\x8b\x8b", 3); /* mov rcx, [rbx+sp] */
+  emit_u32(pic, buf, OFF_SP);
+  emit_bytes(pic, buf, "\x48\x8b\x41\xf8\x48\xbe", 6); /* mov rax, [rcx-8]; mov rsi, mask */
+  emit_u64(pic, buf, 0xfffffffffffful);
+  emit_bytes(pic, buf, "\x48\x21\xf0\x48\x8b\x80", 6); /* and rax, rsi; mov rax, [rax+value] */
+  emit_u32(pic, buf, (unsigned)offsetof(struct pic_box, value));
+  emit_bytes(pic, buf, "\x48\x89\x41\xf8", 4); /* mov [rcx-8], rax */
+}
+
+/* the constant pool is malloc'd and updated in place by the collector */
+static void
+emit_pushconst(pic_state *pic, jit_buffer *buf, pic_value *slot)
+{
+  emit_bytes(pic, buf, "\x48\xb8", 2);  /* mov rax, slot */
+  emit_ptr(pic, buf, slot);
+  emit_bytes(pic, buf, "\x48\x8b\x00", 3); /* mov rax, [rax] */
+  emit_push_rax(pic, buf);
+}
+
+static void
+emit_gref(pic_state *pic, jit_buffer *buf, pic_code *ip, pic_value *slot)
+{
+  jit_label slow = { {0}, 0 }, done = { {0}, 0 };
+
+  emit_bytes(pic, buf, "\x48\xb8", 2);  /* mov rax, slot */
+  emit_ptr(pic, buf, slot);
+  emit_bytes(pic, buf, "\x48\x8b\x00\x48\xbe", 5); /* mov rax, [rax]; mov rsi, mask */
+  emit_u64(pic, buf, 0xfffffffffffful);
+  emit_bytes(pic, buf, "\x48\x21\xf0\x48\x8b\x80", 6); /* and rax, rsi; mov rax, [rax+value] */
+  emit_u32(pic, buf, (unsigned)offsetof(struct pic_box, value));
+  emit_bytes(pic, buf, "\x48\xb9", 2);  /* mov rcx, invalid */
+  emit_u64(pic, buf, pic_invalid_value());
+  emit_bytes(pic, buf, "\x48\x39\xc8", 3); /* cmp rax, rcx */
+  emit_fwd(pic, buf, JE, &slow);
+  emit_push_rax(pic, buf);
+  emit_fwd(pic, buf, JMP, &done);
+  bind_label(buf, &slow);
+  emit_call(pic, buf, pic_vm_jit_helper(OP_GREF), ip); /* reports the error */
+  bind_label(buf, &done);
+}
+
+/**
+ * Binary arithmetic and comparisons on two fixnums. The operator slot and
+ * both operands are replaced with the result; anything else is left to
+ * the helper, which falls back to the interpreter when the primitive has
+ * been redefined.
+ */
+static void
+emit_binop(pic_state *pic, jit_buffer *buf, pic_code *ip)
+{
+  jit_label slow = { {0}, 0 }, done = { {0}, 0 };
+
+  switch (ip->insn) {
+  case OP_ADD: CHECK_PRIM(pic, buf, ADD, &slow); break;
+  case OP_SUB: CHECK_PRIM(pic, buf, SUB, &slow); break;
+  case OP_MUL: CHECK_PRIM(pic, buf, MUL, &slow); break;
+  case OP_EQ: CHECK_PRIM(pic, buf, EQ, &slow); break;
+  case OP_LT: CHECK_PRIM(pic, buf, LT, &slow); break;
+  case OP_LE: CHECK_PRIM(pic, buf, LE, &slow); break;
+  case OP_GT: CHECK_PRIM(pic, buf, GT, &slow); break;
+  case OP_GE: CHECK_PRIM(pic, buf, GE, &slow); break;
+  }
+  emit_bytes(pic, buf, "\x48\x8b\x8b", 3); /* mov rcx, [rbx+sp] */
+  emit_u32(pic, buf, OFF_SP);
+  emit_bytes(pic, buf, "\x48\x8b\x41\xf0\x48\x8b\x51\xf8", 8); /* mov rax, [rcx-16]; mov rdx, [rcx-8] */
+  emit_check_int(pic, buf, false, &slow);
+  emit_check_int(pic, buf, true, &slow);
+
+  switch (ip->insn) {
+  case OP_ADD:
+  case OP_SUB:
+  case OP_MUL:
+    if (ip->insn == OP_ADD) {
+      emit_bytes(pic, buf, "\x01\xd0", 2); /* add eax, edx */
+    } else if (ip->insn == OP_SUB) {
+      emit_bytes(pic, buf, "\x29\xd0", 2); /* sub eax, edx */
+    } else {
+      emit_bytes(pic, buf, "\x0f\xaf\xc2", 3); /* imul eax, edx */
+    }
+    emit_fwd(pic, buf, JO, &slow);
+    emit_box_int(pic, buf);
+    break;
+  default:
+    emit_bytes(pic, buf, "\x39\xd0\x48\xb8", 4); /* cmp eax, edx; mov rax, #f */
+    emit_u64(pic, buf, pic_false_value());
+    emit_bytes(pic, buf, "\x48\xbe", 2);  /* mov rsi, #t */
+    emit_u64(pic, buf, pic_true_value());
+    emit_bytes(pic, buf, "\x48\x0f", 2);  /* cmovcc rax, rsi */
+    switch (ip->insn) {
+    case OP_EQ: emit_byte(pic, buf, 0x44); break;
+    case OP_LT: emit_byte(pic, buf, 0x4c); break;
+    case OP_LE: emit_byte(pic, buf, 0x4e); break;
+    case OP_GT: emit_byte(pic, buf, 0x4f); break;
+    case OP_GE: emit_byte(pic, buf, 0x4d); break;
+    }
+    emit_byte(pic, buf, 0xc6);
+    break;
+  }
+  emit_bytes(pic, buf, "\x48\x89\x41\xe8\x48\x83\xab", 7); /* mov [rcx-24], rax; sub qword [rbx+sp], 16 */
+  emit_u32(pic, buf, OFF_SP);
+  emit_byte(pic, buf, 0x10);
+  emit_fwd(pic, buf, JMP, &done);
+  bind_label(buf, &slow);
+  emit_call(pic, buf, pic_vm_jit_helper(ip->insn), ip);
+  emit_exit_unless_zero(pic, buf, ip);
+  bind_label(buf, &done);
+}
+
+/** superinstructions over a local, continuing at instruction next */
+static void
+emit_super(pic_state *pic, jit_buffer *buf, pic_code *ip, size_t k)
+{
+  jit_label slow = { {0}, 0 };
+  size_t next = k + 3;
+
+  switch (ip->insn) {
+  case OP_LREFCAR: CHECK_PRIM(pic, buf, CAR, &slow); break;
+  case OP_LREFCDR: CHECK_PRIM(pic, buf, CDR, &slow); break;
+  case OP_LREFNILPJMPIF: CHECK_PRIM(pic, buf, NILP, &slow); next = k + 4; break;
+  case OP_LREFADDI: CHECK_PRIM(pic, buf, ADD, &slow); next = k + 4; break;
+  case OP_LREFSUBI: CHECK_PRIM(pic, buf, SUB, &slow); next = k + 4; break;
+  }
+  emit_load_lref(pic, buf, ip[1].u.i);
+
+  switch (ip->insn) {
+  case OP_LREFCAR:
+  case OP_LREFCDR:
+    emit_bytes(pic, buf, "\x48\x89\xc6\x48\xc1\xee\x30\x81\xfe", 9); /* mov rsi, rax; shr rsi, 48; cmp esi, heap */
+    emit_u32(pic, buf, 0xfff0 | PIC_VTYPE_HEAP);
+    emit_fwd(pic, buf, JNE, &slow);
+    emit_bytes(pic, buf, "\x48\xbe", 2); /* mov rsi, mask */
+    emit_u64(pic, buf, 0xfffffffffffful);
+    emit_bytes(pic, buf, "\x48\x21\xf0\x83\x38", 5); /* and rax, rsi; cmp dword [rax], tt */
+    emit_byte(pic, buf, PIC_TT_PAIR);
+    emit_fwd(pic, buf, JNE, &slow);
+    emit_bytes(pic, buf, "\x48\x8b\x40", 3); /* mov rax, [rax+car/cdr] */
+    emit_byte(pic, buf, ip->insn == OP_LREFCAR ? offsetof(struct pic_pair, car) : offsetof(struct pic_pair, cdr));
+    emit_push_rax(pic, buf);
+    break;
+  case OP_LREFNILPJMPIF:
+    emit_bytes(pic, buf, "\x48\xb9", 2);  /* mov rcx, () */
+    emit_u64(pic, buf, pic_nil_value());
+    emit_bytes(pic, buf, "\x48\x39\xc8\x0f\x84", 5); /* cmp rax, rcx; je */
+    emit_rel32(pic, buf, k + 3 + ip[3].u.i);
+    break;
+  case OP_LREFADDI:
+  case OP_LREFSUBI:
+    emit_check_int(pic, buf, false, &slow);
+    emit_byte(pic, buf, ip->insn == OP_LREFADDI ? 0x05 : 0x2d); /* add/sub eax, imm32 */
+    emit_u32(pic, buf, (uint32_t)ip[2].u.i);
+    emit_fwd(pic, buf, JO, &slow);
+    emit_box_int(pic, buf);
+    emit_push_rax(pic, buf);
+    break;
+  }
+  emit_jmp(pic, buf, next);
+
+  bind_label(buf, &slow);
+  emit_call(pic, buf, pic_vm_jit_helper(ip->insn), ip);
+  if (ip->insn == OP_LREFNILPJMPIF) {
+    emit_bytes(pic, buf, "\x85\xc0\x0f\x84", 4); /* test eax, eax; jz */
+    emit_rel32(pic, buf, next);
+    emit_bytes(pic, buf, "\x83\xf8\x02\x0f\x84", 5); /* cmp eax, 2; je */
+    emit_rel32(pic, buf, k + 3 + ip[3].u.i);
+    emit_exit(pic, buf, ip);
+  } else {
+    emit_exit_unless_zero(pic, buf, ip);
+    emit_jmp(pic, buf, next);
+  }
+}
+
+static void
+jit_translate(pic_state *pic, jit_buffer *buf, struct pic_irep *irep, size_t *offsets)
+{
+  size_t k;
+  pic_code *ip;
+  pic_jit_helper helper;
+
+  /* entry: push rbx; mov rbx, rdi; jmp rsi */
+  emit_bytes(pic, buf, "\x53\x48\x89\xfb\xff\xe6", 6);
+
+  for (k = 0; k < irep->clen; ++k) {
+    ip = irep->code + k;
+    offsets[k] = buf->len;
+
+    switch (ip->insn) {
+    case OP_NOP:
+      break;
+    case OP_POP:                /* sub qword [rbx+sp], 8 */
+      emit_bytes(pic, buf, "\x48\x83\xab", 3);
+      emit_u32(pic, buf, OFF_SP);
+      emit_byte(pic, buf, 0x08);
+      break;
+    case OP_PUSHUNDEF:
+      emit_push(pic, buf, pic_undef_value());
+      break;
+    case OP_PUSHNIL:
+      emit_push(pic, buf, pic_nil_value());
+      break;
+    case OP_PUSHTRUE:
+      emit_push(pic, buf, pic_true_value());
+      break;
+    case OP_PUSHFALSE:
+      emit_push(pic, buf, pic_false_value());
+      break;
+    case OP_PUSHINT:
+      emit_push(pic, buf, pic_int_value(ip->u.i));
+      break;
+    case OP_PUSHCHAR:
+      emit_push(pic, buf, pic_char_value(ip->u.c));
+      break;
+    case OP_PUSHCONST:
+      emit_pushconst(pic, buf, irep->pool + ip->u.i);
+      break;
+    case OP_GREF:
+      emit_gref(pic, buf, ip, irep->pool + ip->u.i);
+      break;
+    case OP_LREF:
+      emit_load_lref(pic, buf, ip->u.i);
+      emit_push_rax(pic, buf);
+      break;
+    case OP_CREF:
+      emit_cref(pic, buf, ip->u.i);
+      break;
+    case OP_UNBOX:
+      emit_unbox(pic, buf);
+      break;
+    case OP_JMP:
+      emit_jmp(pic, buf, k + ip->u.i);
+      break;
+    case OP_JMPIF:
+      emit_jmpif(pic, buf, k + ip->u.i);
+      break;
+    case OP_GSET:
+    case OP_LSET:
+    case OP_BOX:
+    case OP_SETBOX:
+    case OP_LAMBDA:
+      emit_call(pic, buf, pic_vm_jit_helper(ip->insn), ip);
+      break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_EQ:
+    case OP_LT:
+    case OP_LE:
+    case OP_GT:
+    case OP_GE:
+      if (ip->u.i == 3) {
+        emit_binop(pic, buf, ip);
+      } else {
+        emit_exit(pic, buf, ip);
+      }
+      break;
+    case OP_LREFCAR:
+    case OP_LREFCDR:
+    case OP_LREFNILPJMPIF:
+    case OP_LREFADDI:
+    case OP_LREFSUBI:
+      emit_super(pic, buf, ip, k);
+      break;
+    default:
+      helper = pic_vm_jit_helper(ip->insn);
+      if (helper != NULL) {
+        emit_call(pic, buf, helper, ip);
+        emit_exit_unless_zero(pic, buf, ip);
+      } else {
+        /* calls, returns and the rest run in the interpreter */
+        emit_exit(pic, buf, ip);
+      }
+      break;
+    }
+  }
+  /* the dead jump over the else branch of an if in tail position */
+  offsets[irep->clen] = buf->len;
+}
+
+void
+pic_jit_compile(pic_state *pic, struct pic_irep *irep)
+{
+  jit_buffer buf;
+  size_t *offsets, i, size;
+  unsigned char *base;
+  int32_t rel;
+
+  buf.capa = 256;
+  buf.len = 0;
+  buf.data = pic_malloc(pic, buf.capa);
+  buf.pcapa = 16;
+  buf.plen = 0;
+  buf.patches = pic_malloc(pic, sizeof(struct jit_patch) * buf.pcapa);
+  offsets = pic_malloc(pic, sizeof(size_t) * (irep->clen + 1));
+
+  jit_translate(pic, &buf, irep, offsets);
+
+  for (i = 0; i < buf.plen; ++i) {
+    rel = (int32_t)(offsets[buf.patches[i].target] - (buf.patches[i].at + 4));
+    memcpy(buf.data + buf.patches[i].at, &rel, 4);
+  }
+
+  size = buf.len;
+  base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base != MAP_FAILED) {
+    memcpy(base, buf.data, size);
+    if (mprotect(base, size, PROT_READ | PROT_EXEC) == 0) {
+      irep->jit = pic_malloc(pic, sizeof(struct pic_jit));
+      irep->jit->base = base;
+      irep->jit->size = size;
+      irep->jit->offsets = offsets;
+      offsets = NULL;
+    } else {
+      munmap(base, size);
+    }
+  }
+  /* the procedure simply stays interpreted if no executable page is available */
+
+  pic_free(pic, offsets);
+  pic_free(pic, buf.patches);
+  pic_free(pic, buf.data);
+}
+
+void
+pic_jit_enter(pic_state *pic, struct pic_irep *irep, pic_code *ip)
+{
+  void (*entry)(pic_state *, void *);
+  void *start;
+
+  *(void **)&entry = irep->jit->base;
+  start = irep->jit->base + irep->jit->offsets[ip - irep->code];
+  entry(pic, start);
+}
+
+void
+pic_jit_free(pic_state *pic, struct pic_irep *irep)
+{
+  if (irep->jit == NULL) {
+    return;
+  }
+  munmap(irep->jit->base, irep->jit->size);
+  pic_free(pic, irep->jit->offsets);
+  pic_free(pic, irep->jit);
+}
+
+#endif
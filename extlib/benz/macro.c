@@ -74,7 +74,7 @@ pic_add_variable(pic_state *pic, struct pic_env *env, pic_value var)
 }
 
 void
-pic_put_variable(pic_state PIC_UNUSED(*pic), struct pic_env *env, pic_value var, pic_sym *uid)
+pic_put_variable(pic_state *pic, struct pic_env *env, pic_value var, pic_sym *uid)
 {
   khiter_t it;
   int ret;
@@ -82,6 +82,8 @@ pic_put_variable(pic_state PIC_UNUSED(*pic), struct pic_env *env, pic_value var,
   assert(pic_var_p(var));
 
   it = kh_put(env, &env->map, pic_ptr(var), &ret);
+  pic_write_barrier(pic, env, var);
+  pic_write_barrier(pic, env, pic_obj_value(uid));
   kh_val(&env->map, it) = uid;
 }
 
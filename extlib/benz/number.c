@@ -9,7 +9,7 @@ pic_number_number_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_float_p(v) || pic_int_p(v));
 }
@@ -19,7 +19,7 @@ pic_number_exact_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_int_p(v));
 }
@@ -29,7 +29,7 @@ pic_number_inexact_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_float_p(v));
 }
@@ -39,7 +39,7 @@ pic_number_inexact(pic_state *pic)
 {
   double f;
 
-  pic_get_args(pic, "f", &f);
+  f = pic_float(pic_arg(pic, 0));
 
   return pic_float_value(f);
 }
@@ -49,7 +49,7 @@ pic_number_exact(pic_state *pic)
 {
   double f;
 
-  pic_get_args(pic, "f", &f);
+  f = pic_float(pic_arg(pic, 0));
 
   return pic_int_value((int)f);
 }
@@ -229,15 +229,15 @@ pic_init_number(pic_state *pic)
 {
   size_t ai = pic_gc_arena_preserve(pic);
 
-  pic_defun(pic, "number?", pic_number_number_p);
+  pic_defun_spec(pic, "number?", pic_number_number_p, "o");
   pic_gc_arena_restore(pic, ai);
 
-  pic_defun(pic, "exact?", pic_number_exact_p);
-  pic_defun(pic, "inexact?", pic_number_inexact_p);
+  pic_defun_spec(pic, "exact?", pic_number_exact_p, "o");
+  pic_defun_spec(pic, "inexact?", pic_number_inexact_p, "o");
   pic_gc_arena_restore(pic, ai);
 
-  pic_defun(pic, "inexact", pic_number_inexact);
-  pic_defun(pic, "exact", pic_number_exact);
+  pic_defun_spec(pic, "inexact", pic_number_inexact, "f");
+  pic_defun_spec(pic, "exact", pic_number_exact, "f");
   pic_gc_arena_restore(pic, ai);
 
   pic_defun(pic, "=", pic_number_eq);
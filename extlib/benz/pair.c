@@ -26,6 +26,7 @@ pic_set_car(pic_state *pic, pic_value obj, pic_value val)
   }
   pair = pic_pair_ptr(obj);
 
+  pic_write_barrier(pic, pair, val);
   pair->car = val;
 }
 
@@ -39,6 +40,7 @@ pic_set_cdr(pic_state *pic, pic_value obj, pic_value val)
   }
   pair = pic_pair_ptr(obj);
 
+  pic_write_barrier(pic, pair, val);
   pair->cdr = val;
 }
 
@@ -389,7 +391,7 @@ pic_list_ref(pic_state *pic, pic_value list, int i)
 void
 pic_list_set(pic_state *pic, pic_value list, int i, pic_value obj)
 {
-  pic_pair_ptr(pic_list_tail(pic, list, i))->car = obj;
+  pic_set_car(pic, pic_list_tail(pic, list, i), obj);
 }
 
 pic_value
@@ -408,7 +410,7 @@ pic_pair_pair_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_pair_p(v));
 }
@@ -418,7 +420,8 @@ pic_pair_cons(pic_state *pic)
 {
   pic_value v,w;
 
-  pic_get_args(pic, "oo", &v, &w);
+  v = pic_arg(pic, 0);
+  w = pic_arg(pic, 1);
 
   return pic_cons(pic, v, w);
 }
@@ -428,7 +431,7 @@ pic_pair_car(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_car(pic, v);
 }
@@ -438,7 +441,7 @@ pic_pair_cdr(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_cdr(pic, v);
 }
@@ -448,7 +451,7 @@ pic_pair_caar(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_caar(pic, v);
 }
@@ -458,7 +461,7 @@ pic_pair_cadr(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_cadr(pic, v);
 }
@@ -468,7 +471,7 @@ pic_pair_cdar(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_cdar(pic, v);
 }
@@ -478,7 +481,7 @@ pic_pair_cddr(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_cddr(pic, v);
 }
@@ -488,7 +491,8 @@ pic_pair_set_car(pic_state *pic)
 {
   pic_value v,w;
 
-  pic_get_args(pic, "oo", &v, &w);
+  v = pic_arg(pic, 0);
+  w = pic_arg(pic, 1);
 
   pic_set_car(pic, v, w);
 
@@ -500,7 +504,8 @@ pic_pair_set_cdr(pic_state *pic)
 {
   pic_value v,w;
 
-  pic_get_args(pic, "oo", &v, &w);
+  v = pic_arg(pic, 0);
+  w = pic_arg(pic, 1);
 
   pic_set_cdr(pic, v, w);
 
@@ -512,7 +517,7 @@ pic_pair_null_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_nil_p(v));
 }
@@ -522,7 +527,7 @@ pic_pair_list_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_list_p(v));
 }
@@ -554,7 +559,7 @@ pic_pair_length(pic_state *pic)
 {
   pic_value list;
 
-  pic_get_args(pic, "o", &list);
+  list = pic_arg(pic, 0);
 
   return pic_int_value(pic_length(pic, list));
 }
@@ -584,7 +589,7 @@ pic_pair_reverse(pic_state *pic)
 {
   pic_value list;
 
-  pic_get_args(pic, "o", &list);
+  list = pic_arg(pic, 0);
 
   return pic_reverse(pic, list);
 }
@@ -595,7 +600,8 @@ pic_pair_list_tail(pic_state *pic)
   pic_value list;
   int i;
 
-  pic_get_args(pic, "oi", &list, &i);
+  list = pic_arg(pic, 0);
+  i = pic_int(pic_arg(pic, 1));
 
   return pic_list_tail(pic, list, i);
 }
@@ -606,7 +612,8 @@ pic_pair_list_ref(pic_state *pic)
   pic_value list;
   int i;
 
-  pic_get_args(pic, "oi", &list, &i);
+  list = pic_arg(pic, 0);
+  i = pic_int(pic_arg(pic, 1));
 
   return pic_list_ref(pic, list, i);
 }
@@ -617,7 +624,9 @@ pic_pair_list_set(pic_state *pic)
   pic_value list, obj;
   int i;
 
-  pic_get_args(pic, "oio", &list, &i, &obj);
+  list = pic_arg(pic, 0);
+  i = pic_int(pic_arg(pic, 1));
+  obj = pic_arg(pic, 2);
 
   pic_list_set(pic, list, i, obj);
 
@@ -629,7 +638,7 @@ pic_pair_list_copy(pic_state *pic)
 {
   pic_value obj;
 
-  pic_get_args(pic, "o", &obj);
+  obj = pic_arg(pic, 0);
 
   return pic_list_copy(pic, obj);
 }
@@ -639,29 +648,32 @@ pic_pair_map(pic_state *pic)
 {
   struct pic_proc *proc;
   int argc, i;
-  pic_value *args;
-  pic_value arg, ret;
+  pic_value *args, *argv;
+  pic_value ret;
+  ptrdiff_t off;
 
   pic_get_args(pic, "l*", &proc, &argc, &args);
+  off = args - pic->ci->fp;
 
   if (argc == 0)
     pic_errorf(pic, "map: wrong number of arguments (1 for at least 2)");
 
   ret = pic_nil_value();
   do {
-    arg = pic_nil_value();
+    argv = pic_apply_argv(pic, argc);
+    args = pic->ci->fp + off;
     for (i = 0; i < argc; ++i) {
       if (! pic_pair_p(args[i])) {
         break;
       }
-      pic_push(pic, pic_car(pic, args[i]), arg);
+      argv[i] = pic_car(pic, args[i]);
       args[i] = pic_cdr(pic, args[i]);
     }
 
     if (i != argc) {
       break;
     }
-    pic_push(pic, pic_apply_list(pic, proc, pic_reverse(pic, arg)), ret);
+    pic_push(pic, pic_apply(pic, proc, argc, argv), ret);
   } while (1);
 
   return pic_reverse(pic, ret);
@@ -672,24 +684,26 @@ pic_pair_for_each(pic_state *pic)
 {
   struct pic_proc *proc;
   int argc, i;
-  pic_value *args;
-  pic_value arg;
+  pic_value *args, *argv;
+  ptrdiff_t off;
 
   pic_get_args(pic, "l*", &proc, &argc, &args);
+  off = args - pic->ci->fp;
 
   do {
-    arg = pic_nil_value();
+    argv = pic_apply_argv(pic, argc);
+    args = pic->ci->fp + off;
     for (i = 0; i < argc; ++i) {
       if (! pic_pair_p(args[i])) {
         break;
       }
-      pic_push(pic, pic_car(pic, args[i]), arg);
+      argv[i] = pic_car(pic, args[i]);
       args[i] = pic_cdr(pic, args[i]);
     }
     if (i != argc) {
       break;
     }
-    pic_apply_list(pic, proc, pic_reverse(pic, arg));
+    pic_apply(pic, proc, argc, argv);
   } while (1);
 
   return pic_undef_value();
@@ -760,29 +774,29 @@ pic_pair_assoc(pic_state *pic)
 void
 pic_init_pair(pic_state *pic)
 {
-  pic_defun(pic, "pair?", pic_pair_pair_p);
-  pic_defun(pic, "cons", pic_pair_cons);
-  pic_defun(pic, "car", pic_pair_car);
-  pic_defun(pic, "cdr", pic_pair_cdr);
-  pic_defun(pic, "null?", pic_pair_null_p);
+  pic_defun_spec(pic, "pair?", pic_pair_pair_p, "o");
+  pic_defun_spec(pic, "cons", pic_pair_cons, "oo");
+  pic_defun_spec(pic, "car", pic_pair_car, "o");
+  pic_defun_spec(pic, "cdr", pic_pair_cdr, "o");
+  pic_defun_spec(pic, "null?", pic_pair_null_p, "o");
 
-  pic_defun(pic, "set-car!", pic_pair_set_car);
-  pic_defun(pic, "set-cdr!", pic_pair_set_cdr);
+  pic_defun_spec(pic, "set-car!", pic_pair_set_car, "oo");
+  pic_defun_spec(pic, "set-cdr!", pic_pair_set_cdr, "oo");
 
-  pic_defun(pic, "caar", pic_pair_caar);
-  pic_defun(pic, "cadr", pic_pair_cadr);
-  pic_defun(pic, "cdar", pic_pair_cdar);
-  pic_defun(pic, "cddr", pic_pair_cddr);
-  pic_defun(pic, "list?", pic_pair_list_p);
+  pic_defun_spec(pic, "caar", pic_pair_caar, "o");
+  pic_defun_spec(pic, "cadr", pic_pair_cadr, "o");
+  pic_defun_spec(pic, "cdar", pic_pair_cdar, "o");
+  pic_defun_spec(pic, "cddr", pic_pair_cddr, "o");
+  pic_defun_spec(pic, "list?", pic_pair_list_p, "o");
   pic_defun(pic, "make-list", pic_pair_make_list);
   pic_defun(pic, "list", pic_pair_list);
-  pic_defun(pic, "length", pic_pair_length);
+  pic_defun_spec(pic, "length", pic_pair_length, "o");
   pic_defun(pic, "append", pic_pair_append);
-  pic_defun(pic, "reverse", pic_pair_reverse);
-  pic_defun(pic, "list-tail", pic_pair_list_tail);
-  pic_defun(pic, "list-ref", pic_pair_list_ref);
-  pic_defun(pic, "list-set!", pic_pair_list_set);
-  pic_defun(pic, "list-copy", pic_pair_list_copy);
+  pic_defun_spec(pic, "reverse", pic_pair_reverse, "o");
+  pic_defun_spec(pic, "list-tail", pic_pair_list_tail, "oi");
+  pic_defun_spec(pic, "list-ref", pic_pair_list_ref, "oi");
+  pic_defun_spec(pic, "list-set!", pic_pair_list_set, "oio");
+  pic_defun_spec(pic, "list-copy", pic_pair_list_copy, "o");
   pic_defun(pic, "map", pic_pair_map);
   pic_defun(pic, "for-each", pic_pair_for_each);
   pic_defun(pic, "memq", pic_pair_memq);
@@ -739,7 +739,7 @@ pic_port_read_blob(pic_state *pic)
     return pic_eof_object();
   }
   else {
-    pic_realloc(pic, blob->data, i);
+    blob->data = pic_gc_realloc(pic, blob->data, k, i);
     blob->len = i;
     return pic_obj_value(blob);
   }
@@ -13,18 +13,72 @@ pic_make_proc(pic_state *pic, pic_func_t func)
   proc->tag = PIC_PROC_TAG_FUNC;
   proc->u.f.func = func;
   proc->u.f.env = NULL;
+  proc->u.f.spec = NULL;
   return proc;
 }
 
+/**
+ * Makes a native whose arguments are described by format, in the notation
+ * of pic_get_args. The VM checks the argument count and types before each
+ * call, so that the native can read its arguments with pic_arg directly.
+ * Only o, i, f, c and the object specifiers are allowed, and i and f
+ * arguments are converted in place: pic_arg then holds an int or a float.
+ */
 struct pic_proc *
-pic_make_proc_irep(pic_state *pic, struct pic_irep *irep, struct pic_context *cxt)
+pic_make_proc_spec(pic_state *pic, pic_func_t func, const char *format)
 {
   struct pic_proc *proc;
+  struct pic_argspec *spec;
+  const char *p;
+  int n = 0;
+  bool opt = false;
+
+  for (p = format; *p; ++p) {
+    if (strchr("oifcsmvblpdre", *p) != NULL) {
+      n++;
+    }
+    else if (*p == '|' && ! opt && p[1] != '\0' && p[1] != '*') {
+      opt = true;
+    }
+    else if (! (*p == '*' && p[1] == '\0')) {
+      pic_errorf(pic, "pic_make_proc_spec: invalid argument specifier '%c' given", *p);
+    }
+  }
 
-  proc = (struct pic_proc *)pic_obj_alloc(pic, sizeof(struct pic_proc), PIC_TT_PROC);
+  spec = pic_malloc(pic, sizeof(struct pic_argspec) + n);
+
+  n = 0;
+  for (p = format; *p && *p != '|' && *p != '*'; ++p) {
+    spec->type[n++] = *p;
+  }
+  spec->req = n;
+  for (p = *p == '|' ? p + 1 : p; *p && *p != '*'; ++p) {
+    spec->type[n++] = *p;
+  }
+  spec->opt = n - spec->req;
+  spec->rest = *p == '*';
+
+  proc = pic_make_proc(pic, func);
+  proc->u.f.spec = spec;
+  return proc;
+}
+
+/**
+ * A closure is flat: the values of its free variables are copied from fv,
+ * which must hold irep->freec of them, into the procedure object itself.
+ */
+struct pic_proc *
+pic_make_proc_irep(pic_state *pic, struct pic_irep *irep, pic_value *fv)
+{
+  struct pic_proc *proc;
+  int i;
+
+  proc = (struct pic_proc *)pic_obj_alloc(pic, sizeof(struct pic_proc) + sizeof(pic_value) * irep->freec, PIC_TT_PROC);
   proc->tag = PIC_PROC_TAG_IREP;
   proc->u.i.irep = irep;
-  proc->u.i.cxt = cxt;
+  for (i = 0; i < irep->freec; ++i) {
+    proc->fv[i] = fv[i];
+  }
   return proc;
 }
 
@@ -34,7 +88,10 @@ pic_proc_env(pic_state *pic, struct pic_proc *proc)
   assert(pic_proc_func_p(proc));
 
   if (! proc->u.f.env) {
-    proc->u.f.env = pic_make_dict(pic);
+    struct pic_dict *env = pic_make_dict(pic);
+
+    pic_write_barrier(pic, proc, pic_obj_value(env));
+    proc->u.f.env = env;
   }
   return proc->u.f.env;
 }
@@ -73,7 +130,6 @@ pic_proc_apply(pic_state *pic)
   struct pic_proc *proc;
   pic_value *args;
   int argc;
-  pic_value arg_list;
 
   pic_get_args(pic, "l*", &proc, &argc, &args);
 
@@ -81,12 +137,7 @@ pic_proc_apply(pic_state *pic)
     pic_errorf(pic, "apply: wrong number of arguments");
   }
 
-  arg_list = args[--argc];
-  while (argc--) {
-    arg_list = pic_cons(pic, args[argc], arg_list);
-  }
-
-  return pic_apply_trampoline_list(pic, proc, arg_list);
+  return pic_vm_apply_spread(pic, proc, argc, args);
 }
 
 void
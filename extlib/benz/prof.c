@@ -0,0 +1,685 @@
+/**
+ * See Copyright Notice in picrin.h
+ */
+
+#include "picrin.h"
+
+#if PIC_USE_SIGPROF
+# include <sys/time.h>
+#endif
+
+/**
+ * The allocation profiler takes a sample every `interval` bytes allocated on
+ * the heap. A sample is the chain of procedures being called, as walked by
+ * pic_get_backtrace, followed by the type of the object being allocated; it
+ * is merged into a call tree whose frames are kept alive for the report.
+ *
+ * The same tree collects the samples of the timer driven profiler. There a
+ * SIGPROF handler only counts ticks; the VM polls the count at calls and
+ * backward jumps and takes the sample there, crediting the innermost frame.
+ */
+
+volatile pic_prof_ticks_t pic_prof_ticks = 0;
+
+KHASH_DECLARE(n, void *, pic_sym *)
+KHASH_DEFINE(n, void *, pic_sym *, kh_ptr_hash_func, kh_ptr_hash_equal)
+
+static struct pic_prof_node *
+prof_child(pic_state *pic, struct pic_prof_node *node, struct pic_object *frame, enum pic_tt tt)
+{
+  struct pic_prof_node *child;
+
+  for (child = node->child; child != NULL; child = child->next) {
+    if (child->frame == frame && (frame != NULL || child->tt == tt)) {
+      return child;
+    }
+  }
+
+  child = pic_malloc(pic, sizeof(struct pic_prof_node));
+  child->frame = frame;
+  child->tt = tt;
+  child->samples = 0;
+  child->child = NULL;
+  child->next = node->child;
+  node->child = child;
+
+  if (frame != NULL) {
+    kv_push(struct pic_object *, pic->prof->frames, frame);
+  }
+  return child;
+}
+
+static struct pic_prof_node *
+prof_walk(pic_state *pic, enum pic_tt tt)
+{
+  struct pic_prof_node *node = &pic->prof->root;
+  pic_callinfo *ci;
+  struct pic_object *frame;
+
+  for (ci = pic->cibase + 1; ci <= pic->ci; ++ci) {
+    if (ci->irep != NULL) {
+      frame = (struct pic_object *)ci->irep;
+    } else if (pic_proc_p(ci->fp[0])) {
+      frame = (struct pic_object *)pic_proc_ptr(ci->fp[0]);
+    } else {
+      continue;
+    }
+    node = prof_child(pic, node, frame, tt);
+  }
+  return node;
+}
+
+static void
+prof_sample(pic_state *pic, size_t samples, enum pic_tt tt)
+{
+  prof_child(pic, prof_walk(pic, tt), NULL, tt)->samples += samples;
+}
+
+/** SIGPROF is blocked while the ticks are taken so that none is lost */
+void
+pic_prof_tick(pic_state *pic)
+{
+  int ticks;
+#if PIC_USE_SIGPROF
+  sigset_t set, old;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGPROF);
+  sigprocmask(SIG_BLOCK, &set, &old);
+#endif
+
+  ticks = (int)pic_prof_ticks;
+  pic_prof_ticks = 0;
+
+#if PIC_USE_SIGPROF
+  sigprocmask(SIG_SETMASK, &old, NULL);
+#endif
+
+  if (pic->prof == NULL || pic->prof->interval != 0) {
+    return;
+  }
+  prof_walk(pic, PIC_TT_PROC)->samples += ticks;
+}
+
+void
+pic_prof_alloc(pic_state *pic, size_t size, enum pic_tt tt)
+{
+  struct pic_prof *prof = pic->prof;
+
+  if (prof->interval == 0) {
+    return;
+  }
+  if (size < prof->left) {
+    prof->left -= size;
+    return;
+  }
+  size -= prof->left;
+  prof->left = prof->interval - size % prof->interval;
+
+  prof_sample(pic, 1 + size / prof->interval, tt);
+}
+
+static void
+prof_free(pic_state *pic, struct pic_prof_node *node)
+{
+  struct pic_prof_node *last, *next;
+
+  while (node != NULL) {
+    if (node->child != NULL) {  /* the children are freed after the siblings */
+      for (last = node->child; last->next != NULL; last = last->next)
+        ;
+      last->next = node->next;
+      node->next = node->child;
+    }
+    next = node->next;
+    pic_free(pic, node);
+    node = next;
+  }
+}
+
+static void
+prof_open(pic_state *pic, size_t interval)
+{
+  struct pic_prof *prof;
+
+  pic_prof_stop(pic);
+
+  prof = pic_malloc(pic, sizeof(struct pic_prof));
+  prof->interval = interval;
+  prof->left = prof->interval;
+  prof->root.frame = NULL;
+  prof->root.samples = 0;
+  prof->root.child = NULL;
+  prof->root.next = NULL;
+  kv_init(prof->frames);
+
+  pic->prof = prof;
+}
+
+void
+pic_prof_start(pic_state *pic, size_t interval)
+{
+  prof_open(pic, interval > 0 ? interval : 1);
+}
+
+#if PIC_USE_SIGPROF
+
+static struct sigaction prof_oldact;
+
+static void
+prof_signal(int sig)
+{
+  (void)sig;
+
+  pic_prof_ticks++;
+}
+
+static void
+prof_timer(long usec)
+{
+  struct itimerval it;
+
+  it.it_interval.tv_sec = usec / 1000000;
+  it.it_interval.tv_usec = usec % 1000000;
+  it.it_value = it.it_interval;
+  setitimer(ITIMER_PROF, &it, NULL);
+}
+
+#endif
+
+/**
+ * Samples the call chain every `usec` microseconds of CPU time. Only one
+ * pic_state in the process can be sampled at a time, as the ticks are
+ * counted by a process-wide signal handler.
+ */
+void
+pic_prof_start_timer(pic_state *pic, int usec)
+{
+#if PIC_USE_SIGPROF
+  struct sigaction act;
+
+  prof_open(pic, 0);
+
+  pic_prof_ticks = 0;
+  act.sa_handler = prof_signal;
+  act.sa_flags = SA_RESTART;
+  sigemptyset(&act.sa_mask);
+  sigaction(SIGPROF, &act, &prof_oldact);
+  prof_timer(usec > 0 ? usec : 1);
+#else
+  (void)usec;
+  pic_errorf(pic, "sampling profiler is not available on this platform");
+#endif
+}
+
+void
+pic_prof_stop(pic_state *pic)
+{
+  struct pic_prof *prof = pic->prof;
+
+  if (prof == NULL) {
+    return;
+  }
+  pic->prof = NULL;
+
+#if PIC_USE_SIGPROF
+  if (prof->interval == 0) {
+    prof_timer(0);
+    sigaction(SIGPROF, &prof_oldact, NULL);
+    pic_prof_ticks = 0;
+  }
+#endif
+
+  prof_free(pic, prof->root.child);
+  kv_destroy(prof->frames);
+  pic_free(pic, prof);
+}
+
+/* global variable names of procedures, stripped of their unique suffix */
+static void
+prof_print_name(pic_state *pic, pic_sym *sym, xFILE *file)
+{
+  const char *name, *dot, *p;
+
+  if (sym == NULL) {
+    xfputs(pic, "(anonymous lambda)", file);
+    return;
+  }
+  name = pic_symbol_name(pic, sym);
+
+  dot = NULL;
+  for (p = name; *p; ++p) {
+    if (*p == '.') {
+      dot = p;
+    } else if (dot != NULL && (*p < '0' || '9' < *p)) {
+      dot = NULL;
+    }
+  }
+  for (p = name; *p && p != dot; ++p) {
+    xfputc(pic, *p, file);
+  }
+}
+
+static void
+prof_print_frame(pic_state *pic, khash_t(n) *names, struct pic_object *frame, xFILE *file)
+{
+  khiter_t it;
+
+  it = kh_get(n, names, frame);
+  prof_print_name(pic, it == kh_end(names) ? NULL : kh_val(names, it), file);
+}
+
+/**
+ * Writes the samples in the folded format of flame graph tools: one line
+ * per call chain (ending in the allocated type for allocation samples), with
+ * frames separated by semicolons, followed by the number of samples taken
+ * there.
+ */
+void
+pic_prof_report(pic_state *pic, xFILE *file)
+{
+  struct pic_prof *prof = pic->prof;
+  kvec_t(struct pic_prof_node *) path;
+  khash_t(n) names;
+  khash_t(reg) *h;
+  struct pic_prof_node *node;
+  struct pic_proc *proc;
+  pic_value v;
+  khiter_t it;
+  size_t i;
+  int ret;
+
+  if (prof == NULL) {
+    return;
+  }
+
+  kh_init(n, &names);
+  h = &pic->globals->hash;
+  for (it = kh_begin(h); it != kh_end(h); ++it) {
+    if (! kh_exist(h, it))
+      continue;
+    v = pic_box_ptr(kh_val(h, it))->value;
+    if (! pic_proc_p(v))
+      continue;
+    proc = pic_proc_ptr(v);
+    if (pic_proc_irep_p(proc)) {
+      i = kh_put(n, &names, proc->u.i.irep, &ret);
+    } else {
+      i = kh_put(n, &names, proc, &ret);
+    }
+    kh_val(&names, i) = kh_key(h, it);
+  }
+
+  kv_init(path);
+  node = prof->root.child;
+  while (node != NULL) {
+    if (node->samples > 0) {
+      for (i = 0; i < kv_size(path); ++i) {
+        prof_print_frame(pic, &names, kv_A(path, i)->frame, file);
+        xfputc(pic, ';', file);
+      }
+      if (node->frame != NULL) {
+        prof_print_frame(pic, &names, node->frame, file);
+      } else {
+        xfputs(pic, pic_type_repr(node->tt), file);
+      }
+      xfprintf(pic, file, " %d\n", (int)node->samples);
+    }
+    if (node->child != NULL) {
+      kv_push(struct pic_prof_node *, path, node);
+      node = node->child;
+      continue;
+    }
+
+    while (node->next == NULL && kv_size(path) > 0) {
+      node = kv_pop(path);
+    }
+    node = node->next;
+  }
+  kv_destroy(path);
+  kh_destroy(n, &names);
+}
+
+#if VM_PROFILE
+
+#include "picrin/opcode.h"
+#include <time.h>
+
+/**
+ * The bytecode profiler counts every instruction executed, per opcode and
+ * per procedure, and times the procedures at their calls and returns. The
+ * time between two such events is charged to the frame on top of the stack
+ * as self time; an activation adds to its procedure's total time only if
+ * no other activation of the same procedure is below it, so recursion is
+ * not counted twice. Frames dropped by an escape are closed by
+ * pic_vm_prof_unwind.
+ */
+
+static const char *opcode_names[] = {
+  "NOP", "POP", "PUSHUNDEF", "PUSHNIL", "PUSHTRUE", "PUSHFALSE", "PUSHINT",
+  "PUSHCHAR", "PUSHCONST", "GREF", "GSET", "LREF", "LSET", "CREF", "BOX",
+  "UNBOX", "SETBOX", "JMP", "JMPIF", "NOT", "CALL", "TAILCALL", "RET",
+  "LAMBDA", "CONS", "CAR", "CDR", "NILP", "SYMBOLP", "PAIRP", "ADD", "SUB",
+  "MUL", "DIV", "EQ", "LT", "LE", "GT", "GE", "LREFCAR", "LREFCDR",
+  "LREFNILPJMPIF", "LREFADDI", "LREFSUBI", "RESTNILP", "RESTPAIRP", "RESTCAR",
+  "LREFREST", "APPLYREST", "RCONS", "RCAR", "RCDR", "RNILP", "RSYMBOLP",
+  "RPAIRP", "RNOT", "RADD", "RSUB", "RMUL", "RDIV", "REQ", "RLT", "RLE", "RGT",
+  "RGE", "STOP"
+};
+
+#define VM_PROF_OPS (OP_STOP + 1)
+
+/* function pointers cannot be cast to integers portably */
+static khint_t
+vm_prof_hash(pic_func_t func)
+{
+  const unsigned char *p = (const unsigned char *)&func;
+  khint_t h = 0;
+  size_t i;
+
+  for (i = 0; i < sizeof func; ++i) {
+    h = h * 31 + p[i];
+  }
+  return h;
+}
+
+#define vm_prof_equal(a, b) ((a) == (b))
+
+KHASH_DEFINE(vmprof, pic_func_t, struct pic_vm_prof_entry *, vm_prof_hash, vm_prof_equal)
+
+static double
+vm_prof_clock(void)
+{
+#if defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+  return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+void
+pic_vm_prof_init(pic_state *pic)
+{
+  struct pic_vm_prof *prof;
+
+  prof = pic_malloc(pic, sizeof(struct pic_vm_prof));
+  prof->entries = NULL;
+  kh_init(vmprof, &prof->natives);
+  prof->ops = pic_calloc(pic, VM_PROF_OPS, sizeof(size_t));
+  prof->last = vm_prof_clock();
+
+  pic->vmprof = prof;
+  pic->cibase->prof = NULL;
+}
+
+void
+pic_vm_prof_close(pic_state *pic)
+{
+  struct pic_vm_prof *prof = pic->vmprof;
+  struct pic_vm_prof_entry *e, *next;
+
+  for (e = prof->entries; e != NULL; e = next) {
+    next = e->next;
+    pic_free(pic, e);
+  }
+  kh_destroy(vmprof, &prof->natives);
+  pic_free(pic, prof->ops);
+  pic_free(pic, prof);
+}
+
+static struct pic_vm_prof_entry *
+vm_prof_entry(pic_state *pic, struct pic_proc *proc)
+{
+  struct pic_vm_prof *prof = pic->vmprof;
+  struct pic_vm_prof_entry *e, **slot;
+  khiter_t it;
+  int ret;
+
+  if (pic_proc_irep_p(proc)) {
+    slot = &proc->u.i.irep->prof;
+    if (*slot != NULL) {
+      return *slot;
+    }
+  } else {
+    it = kh_put(vmprof, &prof->natives, proc->u.f.func, &ret);
+    if (ret == 0) {
+      return kh_val(&prof->natives, it);
+    }
+    slot = &kh_val(&prof->natives, it);
+  }
+
+  e = pic_calloc(pic, 1, sizeof(struct pic_vm_prof_entry));
+  e->irep = pic_proc_irep_p(proc) ? proc->u.i.irep : NULL;
+  e->func = pic_proc_func_p(proc) ? proc->u.f.func : NULL;
+  e->next = prof->entries;
+  prof->entries = e;
+
+  return *slot = e;
+}
+
+/* the frame on top of the stack has been running since the last event */
+static void
+vm_prof_charge(struct pic_vm_prof *prof, pic_callinfo *ci, double now)
+{
+  if (ci->prof != NULL) {
+    ci->prof->self += now - prof->last;
+  }
+  prof->last = now;
+}
+
+static void
+vm_prof_close(pic_callinfo *ci, double now)
+{
+  if (ci->prof != NULL && --ci->prof->active == 0) {
+    ci->prof->total += now - ci->start;
+  }
+}
+
+void
+pic_vm_prof_enter(pic_state *pic, pic_callinfo *ci, struct pic_proc *proc)
+{
+  double now = vm_prof_clock();
+  struct pic_vm_prof_entry *e;
+
+  vm_prof_charge(pic->vmprof, ci - 1, now);
+
+  e = vm_prof_entry(pic, proc);
+  e->calls++;
+  ci->prof = e;
+  ci->start = e->active++ == 0 ? now : -1;
+}
+
+void
+pic_vm_prof_leave(pic_state *pic, pic_callinfo *ci)
+{
+  double now = vm_prof_clock();
+
+  vm_prof_charge(pic->vmprof, ci, now);
+  vm_prof_close(ci, now);
+}
+
+/* close the frames above ci before the stack is cut back to it */
+void
+pic_vm_prof_unwind(pic_state *pic, pic_callinfo *ci)
+{
+  double now = vm_prof_clock();
+  pic_callinfo *top;
+
+  if (pic->ci > ci) {
+    vm_prof_charge(pic->vmprof, pic->ci, now);
+  }
+  for (top = pic->ci; top > ci; --top) {
+    vm_prof_close(top, now);
+  }
+}
+
+/* open the frames of a stack that has been put back in place */
+void
+pic_vm_prof_rewind(pic_state *pic)
+{
+  double now = vm_prof_clock();
+  pic_callinfo *ci;
+
+  for (ci = pic->cibase + 1; ci <= pic->ci; ++ci) {
+    if (ci->prof != NULL) {
+      ci->start = ci->prof->active++ == 0 ? now : -1;
+    }
+  }
+  pic->vmprof->last = now;
+}
+
+/* settle the time of the frames still running, as if they returned now */
+static void
+vm_prof_settle(pic_state *pic, double now)
+{
+  pic_callinfo *ci;
+
+  vm_prof_charge(pic->vmprof, pic->ci, now);
+
+  for (ci = pic->cibase + 1; ci <= pic->ci; ++ci) {
+    if (ci->prof != NULL && ci->start >= 0) {
+      ci->prof->total += now - ci->start;
+      ci->start = now;
+    }
+  }
+}
+
+void
+pic_vm_prof_reset(pic_state *pic)
+{
+  struct pic_vm_prof *prof = pic->vmprof;
+  struct pic_vm_prof_entry *e;
+  size_t i;
+
+  vm_prof_settle(pic, vm_prof_clock());
+
+  for (e = prof->entries; e != NULL; e = e->next) {
+    e->calls = e->insns = 0;
+    e->self = e->total = 0;
+  }
+  for (i = 0; i < VM_PROF_OPS; ++i) {
+    prof->ops[i] = 0;
+  }
+}
+
+/* right-aligned in width columns, with a decimal point before the last point digits */
+static void
+vm_prof_print_count(pic_state *pic, size_t n, int point, int width, xFILE *file)
+{
+  char buf[32];
+  int i = 0;
+
+  do {
+    if (i == point && point > 0) {
+      buf[i++] = '.';
+    }
+    buf[i++] = (char)('0' + n % 10);
+    n /= 10;
+  } while (n != 0 || i <= point);
+
+  while (width-- > i) {
+    xfputc(pic, ' ', file);
+  }
+  while (i-- > 0) {
+    xfputc(pic, buf[i], file);
+  }
+}
+
+/* milliseconds with three decimals */
+#define vm_prof_print_time(pic, t, file) vm_prof_print_count(pic, (size_t)((t) * 1e6 + 0.5), 3, 12, file)
+
+/**
+ * Writes a table of the procedures called since the last reset, hottest
+ * first by self time, followed by the executions of each opcode.
+ */
+void
+pic_vm_prof_report(pic_state *pic, xFILE *file)
+{
+  struct pic_vm_prof *prof = pic->vmprof;
+  struct pic_vm_prof_entry *e, **sorted;
+  khash_t(reg) *h;
+  struct pic_proc *proc;
+  pic_value v;
+  khiter_t it, k;
+  size_t i, j, n, ops[VM_PROF_OPS];
+
+  vm_prof_settle(pic, vm_prof_clock());
+
+  n = 0;
+  for (e = prof->entries; e != NULL; e = e->next) {
+    e->name = NULL;
+    n += e->calls > 0;
+  }
+
+  h = &pic->globals->hash;
+  for (it = kh_begin(h); it != kh_end(h); ++it) {
+    if (! kh_exist(h, it))
+      continue;
+    v = pic_box_ptr(kh_val(h, it))->value;
+    if (! pic_proc_p(v))
+      continue;
+    proc = pic_proc_ptr(v);
+    if (pic_proc_irep_p(proc)) {
+      e = proc->u.i.irep->prof;
+    } else {
+      k = kh_get(vmprof, &prof->natives, proc->u.f.func);
+      e = k == kh_end(&prof->natives) ? NULL : kh_val(&prof->natives, k);
+    }
+    if (e != NULL && e->name == NULL) {
+      e->name = kh_key(h, it);
+    }
+  }
+
+  /* insertion sort, by self time */
+  sorted = pic_malloc(pic, sizeof(struct pic_vm_prof_entry *) * (n + 1));
+  i = 0;
+  for (e = prof->entries; e != NULL; e = e->next) {
+    if (e->calls == 0)
+      continue;
+    for (j = i++; j > 0 && sorted[j - 1]->self < e->self; --j) {
+      sorted[j] = sorted[j - 1];
+    }
+    sorted[j] = e;
+  }
+
+  xfputs(pic, "     self ms    total ms       calls  instructions  procedure\n", file);
+  for (i = 0; i < n; ++i) {
+    e = sorted[i];
+    vm_prof_print_time(pic, e->self, file);
+    vm_prof_print_time(pic, e->total, file);
+    vm_prof_print_count(pic, e->calls, 0, 12, file);
+    vm_prof_print_count(pic, e->insns, 0, 14, file);
+    xfputs(pic, "  ", file);
+    if (e->func != NULL && e->name == NULL) {
+      xfputs(pic, "(native function)", file);
+    } else {
+      prof_print_name(pic, e->name, file);
+    }
+    xfputc(pic, '\n', file);
+  }
+  pic_free(pic, sorted);
+
+  /* opcodes, most executed first */
+  for (i = 0; i < VM_PROF_OPS; ++i) {
+    ops[i] = i;
+  }
+  for (i = 1; i < VM_PROF_OPS; ++i) {
+    for (j = i, n = ops[i]; j > 0 && prof->ops[ops[j - 1]] < prof->ops[n]; --j) {
+      ops[j] = ops[j - 1];
+    }
+    ops[j] = n;
+  }
+
+  xfputs(pic, "\n  executions  opcode\n", file);
+  for (i = 0; i < VM_PROF_OPS && prof->ops[ops[i]] > 0; ++i) {
+    vm_prof_print_count(pic, prof->ops[ops[i]], 0, 12, file);
+    xfputs(pic, "  ", file);
+    xfputs(pic, opcode_names[ops[i]], file);
+    xfputc(pic, '\n', file);
+  }
+}
+
+#endif
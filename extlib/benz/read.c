@@ -668,8 +668,8 @@ read_label_set(pic_state *pic, struct pic_port *port, int i)
       kh_val(h, it) = val = pic_cons(pic, pic_undef_value(), pic_undef_value());
 
       tmp = read(pic, port, c);
-      pic_pair_ptr(val)->car = pic_car(pic, tmp);
-      pic_pair_ptr(val)->cdr = pic_cdr(pic, tmp);
+      pic_set_car(pic, val, pic_car(pic, tmp));
+      pic_set_cdr(pic, val, pic_cdr(pic, tmp));
 
       return val;
     }
@@ -691,6 +691,7 @@ read_label_set(pic_state *pic, struct pic_port *port, int i)
         tmp = pic_vec_ptr(read(pic, port, c));
         PIC_SWAP(pic_value *, tmp->data, pic_vec_ptr(val)->data);
         PIC_SWAP(int, tmp->len, pic_vec_ptr(val)->len);
+        pic_gc_remember(pic, pic_vec_ptr(val));
 
         return val;
       }
@@ -32,13 +32,15 @@ pic_reg_ref(pic_state *pic, struct pic_reg *reg, void *key)
 }
 
 void
-pic_reg_set(pic_state PIC_UNUSED(*pic), struct pic_reg *reg, void *key, pic_value val)
+pic_reg_set(pic_state *pic, struct pic_reg *reg, void *key, pic_value val)
 {
   khash_t(reg) *h = &reg->hash;
   int ret;
   khiter_t it;
 
   it = kh_put(reg, h, key, &ret);
+  pic_write_barrier(pic, reg, pic_obj_value(key));
+  pic_write_barrier(pic, reg, val);
   kh_val(h, it) = val;
 }
 
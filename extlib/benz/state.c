@@ -159,6 +159,7 @@ pic_init_core(pic_state *pic)
     VM(pic->uLE, "<=");
     VM(pic->uGT, ">");
     VM(pic->uGE, ">=");
+    VM(pic->uAPPLY, "apply");
 
     pic_init_bool(pic); DONE;
     pic_init_pair(pic); DONE;
@@ -199,6 +200,7 @@ pic_init_core(pic_state *pic)
     VM3(LE);
     VM3(GT);
     VM3(GE);
+    VM3(APPLY);
 
     VM2(pic->pCONS, "cons");
     VM2(pic->pCAR, "car");
@@ -216,6 +218,7 @@ pic_init_core(pic_state *pic)
     VM2(pic->pLE, "<=");
     VM2(pic->pGT, ">");
     VM2(pic->pGE, ">=");
+    VM2(pic->pAPPLY, "apply");
 
     pic_try {
       pic_load_cstr(pic, &pic_boot[0][0]);
@@ -278,6 +281,8 @@ pic_open(pic_allocf allocf, void *userdata)
   if (! pic->ci) {
     goto EXIT_CI;
   }
+  pic->ci->irep = NULL;         /* the bottom frame runs no bytecode */
+  pic->ci->fp = pic->stbase;
 
   /* exception handler */
   pic->xpbase = pic->xp = allocf(userdata, NULL, PIC_RESCUE_SIZE * sizeof(struct pic_proc *));
@@ -299,6 +304,14 @@ pic_open(pic_allocf allocf, void *userdata)
   /* memory heap */
   pic->heap = pic_heap_open(pic);
 
+  /* allocation profiler */
+  pic->prof = NULL;
+
+#if VM_PROFILE
+  /* bytecode profiler */
+  pic_vm_prof_init(pic);
+#endif
+
   /* symbol table */
   kh_init(s, &pic->syms);
 
@@ -381,6 +394,7 @@ pic_open(pic_allocf allocf, void *userdata)
   U(uGT, ">");
   U(uGE, ">=");
   U(uNOT, "not");
+  U(uAPPLY, "apply");
   pic_gc_arena_restore(pic, ai);
 
   /* system procedures */
@@ -400,6 +414,7 @@ pic_open(pic_allocf allocf, void *userdata)
   pic->pLE = pic_invalid_value();
   pic->pGT = pic_invalid_value();
   pic->pGE = pic_invalid_value();
+  pic->pAPPLY = pic_invalid_value();
 
   /* root tables */
   pic->globals = pic_make_reg(pic);
@@ -426,9 +441,6 @@ pic_open(pic_allocf allocf, void *userdata)
 
   pic_gc_arena_restore(pic, ai);
 
-  /* turn on GC */
-  pic->gc_enable = true;
-
   pic->cCONS = pic_box(pic, pic_invalid_value());
   pic->cCAR = pic_box(pic, pic_invalid_value());
   pic->cCDR = pic_box(pic, pic_invalid_value());
@@ -445,6 +457,10 @@ pic_open(pic_allocf allocf, void *userdata)
   pic->cLE = pic_box(pic, pic_invalid_value());
   pic->cGT = pic_box(pic, pic_invalid_value());
   pic->cGE = pic_box(pic, pic_invalid_value());
+  pic->cAPPLY = pic_box(pic, pic_invalid_value());
+
+  /* turn on GC */
+  pic->gc_enable = true;
 
   pic_init_core(pic);
 
@@ -481,6 +497,7 @@ pic_close(pic_state *pic)
   pic->attrs = NULL;
   pic->features = pic_nil_value();
   pic->libs = pic_nil_value();
+  pic_prof_stop(pic);
 
   /* free all heap objects */
   pic_gc_run(pic);
@@ -494,6 +511,10 @@ pic_close(pic_state *pic)
   /* free reader struct */
   pic_reader_destroy(pic);
 
+#if VM_PROFILE
+  pic_vm_prof_close(pic);
+#endif
+
   /* free runtime context */
   allocf(pic->userdata, pic->stbase, 0);
   allocf(pic->userdata, pic->cibase, 0);
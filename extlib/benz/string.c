@@ -11,6 +11,8 @@ struct pic_chunk {
   char buf[1];
 };
 
+#define CHUNK_SIZE(len) (sizeof(struct pic_chunk) + (len))
+
 struct pic_rope {
   int refcnt;
   size_t weight;
@@ -28,7 +30,7 @@ struct pic_rope {
     if (! --c_->refcnt) {                       \
       if (c_->str != c_->buf)                   \
         pic_free(pic, c_->str);                 \
-      pic_free(pic, c_);                        \
+      pic_gc_free(pic, c_, CHUNK_SIZE(c_->len)); \
     }                                           \
   } while (0)
 
@@ -56,7 +58,7 @@ pic_make_chunk(pic_state *pic, const char *str, size_t len)
 {
   struct pic_chunk *c;
 
-  c = pic_malloc(pic, sizeof(struct pic_chunk) + len);
+  c = pic_gc_malloc(pic, CHUNK_SIZE(len));
   c->refcnt = 1;
   c->str = c->buf;
   c->len = len;
@@ -213,7 +215,7 @@ rope_cstr(pic_state *pic, struct pic_rope *x)
     return x->chunk->str;       /* reuse cached chunk */
   }
 
-  c = pic_malloc(pic, sizeof(struct pic_chunk) + x->weight);
+  c = pic_gc_malloc(pic, CHUNK_SIZE(x->weight));
   c->refcnt = 1;
   c->len = x->weight;
   c->str = c->buf;
@@ -417,7 +419,7 @@ pic_str_string_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_str_p(v));
 }
@@ -469,7 +471,7 @@ pic_str_string_length(pic_state *pic)
 {
   pic_str *str;
 
-  pic_get_args(pic, "s", &str);
+  str = pic_str_ptr(pic_arg(pic, 0));
 
   return pic_int_value(pic_str_len(str));
 }
@@ -480,7 +482,8 @@ pic_str_string_ref(pic_state *pic)
   pic_str *str;
   int k;
 
-  pic_get_args(pic, "si", &str, &k);
+  str = pic_str_ptr(pic_arg(pic, 0));
+  k = pic_int(pic_arg(pic, 1));
 
   return pic_char_value(pic_str_ref(pic, str, k));
 }
@@ -556,12 +559,14 @@ static pic_value
 pic_str_string_map(pic_state *pic)
 {
   struct pic_proc *proc;
-  pic_value *argv, vals, val;
+  pic_value *argv, *vals, val;
   int argc, i, len, j;
   pic_str *str;
   char *buf;
+  ptrdiff_t off;
 
   pic_get_args(pic, "l*", &proc, &argc, &argv);
+  off = argv - pic->ci->fp;
 
   if (argc == 0) {
     pic_errorf(pic, "string-map: one or more strings expected, but got zero");
@@ -580,11 +585,12 @@ pic_str_string_map(pic_state *pic)
 
   pic_try {
     for (i = 0; i < len; ++i) {
-      vals = pic_nil_value();
+      vals = pic_apply_argv(pic, argc);
+      argv = pic->ci->fp + off;
       for (j = 0; j < argc; ++j) {
-        pic_push(pic, pic_char_value(pic_str_ref(pic, pic_str_ptr(argv[j]), i)), vals);
+        vals[j] = pic_char_value(pic_str_ref(pic, pic_str_ptr(argv[j]), i));
       }
-      val = pic_apply_list(pic, proc, vals);
+      val = pic_apply(pic, proc, argc, vals);
 
       pic_assert_type(pic, val, char);
       buf[i] = pic_char(val);
@@ -606,9 +612,11 @@ pic_str_string_for_each(pic_state *pic)
 {
   struct pic_proc *proc;
   int argc, len, i, j;
-  pic_value *argv, vals;
+  pic_value *argv, *vals;
+  ptrdiff_t off;
 
   pic_get_args(pic, "l*", &proc, &argc, &argv);
+  off = argv - pic->ci->fp;
 
   if (argc == 0) {
     pic_errorf(pic, "string-map: one or more strings expected, but got zero");
@@ -625,11 +633,12 @@ pic_str_string_for_each(pic_state *pic)
   }
 
   for (i = 0; i < len; ++i) {
-    vals = pic_nil_value();
+    vals = pic_apply_argv(pic, argc);
+    argv = pic->ci->fp + off;
     for (j = 0; j < argc; ++j) {
-      pic_push(pic, pic_char_value(pic_str_ref(pic, pic_str_ptr(argv[j]), i)), vals);
+      vals[j] = pic_char_value(pic_str_ref(pic, pic_str_ptr(argv[j]), i));
     }
-    pic_apply_list(pic, proc, vals);
+    pic_apply(pic, proc, argc, vals);
   }
 
   return pic_undef_value();
@@ -697,11 +706,11 @@ pic_str_string_to_list(pic_state *pic)
 void
 pic_init_str(pic_state *pic)
 {
-  pic_defun(pic, "string?", pic_str_string_p);
+  pic_defun_spec(pic, "string?", pic_str_string_p, "o");
   pic_defun(pic, "string", pic_str_string);
   pic_defun(pic, "make-string", pic_str_make_string);
-  pic_defun(pic, "string-length", pic_str_string_length);
-  pic_defun(pic, "string-ref", pic_str_string_ref);
+  pic_defun_spec(pic, "string-length", pic_str_string_length, "s");
+  pic_defun_spec(pic, "string-ref", pic_str_string_ref, "si");
   pic_defun(pic, "string-copy", pic_str_string_copy);
   pic_defun(pic, "string-append", pic_str_string_append);
   pic_defun(pic, "string-map", pic_str_string_map);
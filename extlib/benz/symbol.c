@@ -52,7 +52,7 @@ pic_symbol_symbol_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_sym_p(v));
 }
@@ -81,7 +81,7 @@ pic_symbol_symbol_to_string(pic_state *pic)
 {
   pic_sym *sym;
 
-  pic_get_args(pic, "m", &sym);
+  sym = pic_sym_ptr(pic_arg(pic, 0));
 
   return pic_obj_value(pic_make_str_cstr(pic, sym->cstr));
 }
@@ -91,7 +91,7 @@ pic_symbol_string_to_symbol(pic_state *pic)
 {
   pic_str *str;
 
-  pic_get_args(pic, "s", &str);
+  str = pic_str_ptr(pic_arg(pic, 0));
 
   return pic_obj_value(pic_intern_str(pic, str));
 }
@@ -99,10 +99,10 @@ pic_symbol_string_to_symbol(pic_state *pic)
 void
 pic_init_symbol(pic_state *pic)
 {
-  pic_defun(pic, "symbol?", pic_symbol_symbol_p);
+  pic_defun_spec(pic, "symbol?", pic_symbol_symbol_p, "o");
 
-  pic_defun(pic, "symbol->string", pic_symbol_symbol_to_string);
-  pic_defun(pic, "string->symbol", pic_symbol_string_to_symbol);
+  pic_defun_spec(pic, "symbol->string", pic_symbol_symbol_to_string, "m");
+  pic_defun_spec(pic, "string->symbol", pic_symbol_string_to_symbol, "s");
 
   pic_defun(pic, "symbol=?", pic_symbol_symbol_eq_p);
 }
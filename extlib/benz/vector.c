@@ -12,7 +12,7 @@ pic_make_vec(pic_state *pic, int len)
 
   vec = (struct pic_vector *)pic_obj_alloc(pic, sizeof(struct pic_vector), PIC_TT_VECTOR);
   vec->len = len;
-  vec->data = (pic_value *)pic_malloc(pic, sizeof(pic_value) * len);
+  vec->data = (pic_value *)pic_gc_malloc(pic, sizeof(pic_value) * len);
   for (i = 0; i < len; ++i) {
     vec->data[i] = pic_undef_value();
   }
@@ -24,7 +24,7 @@ pic_vec_vector_p(pic_state *pic)
 {
   pic_value v;
 
-  pic_get_args(pic, "o", &v);
+  v = pic_arg(pic, 0);
 
   return pic_bool_value(pic_vec_p(v));
 }
@@ -70,7 +70,7 @@ pic_vec_vector_length(pic_state *pic)
 {
   struct pic_vector *v;
 
-  pic_get_args(pic, "v", &v);
+  v = pic_vec_ptr(pic_arg(pic, 0));
 
   return pic_int_value(v->len);
 }
@@ -81,7 +81,8 @@ pic_vec_vector_ref(pic_state *pic)
   struct pic_vector *v;
   int k;
 
-  pic_get_args(pic, "vi", &v, &k);
+  v = pic_vec_ptr(pic_arg(pic, 0));
+  k = pic_int(pic_arg(pic, 1));
 
   if (v->len <= k) {
     pic_errorf(pic, "vector-ref: index out of range");
@@ -96,11 +97,14 @@ pic_vec_vector_set(pic_state *pic)
   int k;
   pic_value o;
 
-  pic_get_args(pic, "vio", &v, &k, &o);
+  v = pic_vec_ptr(pic_arg(pic, 0));
+  k = pic_int(pic_arg(pic, 1));
+  o = pic_arg(pic, 2);
 
   if (v->len <= k) {
     pic_errorf(pic, "vector-set!: index out of range");
   }
+  pic_write_barrier(pic, v, o);
   v->data[k] = o;
   return pic_undef_value();
 }
@@ -129,6 +133,8 @@ pic_vec_vector_copy_i(pic_state *pic)
     return pic_undef_value();
   }
 
+  pic_gc_remember(pic, to);
+
   while (start < end) {
     to->data[at++] = from->data[start++];
   }
@@ -207,6 +213,8 @@ pic_vec_vector_fill_i(pic_state *pic)
     end = vec->len;
   }
 
+  pic_write_barrier(pic, vec, obj);
+
   while (start < end) {
     vec->data[start++] = obj;
   }
@@ -219,10 +227,12 @@ pic_vec_vector_map(pic_state *pic)
 {
   struct pic_proc *proc;
   int argc, i, len, j;
-  pic_value *argv, vals;
+  pic_value *argv, *vals, val;
   pic_vec *vec;
+  ptrdiff_t off;
 
   pic_get_args(pic, "l*", &proc, &argc, &argv);
+  off = argv - pic->ci->fp;
 
   len = INT_MAX;
   for (i = 0; i < argc; ++i) {
@@ -236,11 +246,14 @@ pic_vec_vector_map(pic_state *pic)
   vec = pic_make_vec(pic, len);
 
   for (i = 0; i < len; ++i) {
-    vals = pic_nil_value();
+    vals = pic_apply_argv(pic, argc);
+    argv = pic->ci->fp + off;
     for (j = 0; j < argc; ++j) {
-      pic_push(pic, pic_vec_ptr(argv[j])->data[i], vals);
+      vals[j] = pic_vec_ptr(argv[j])->data[i];
     }
-    vec->data[i] = pic_apply_list(pic, proc, vals);
+    val = pic_apply(pic, proc, argc, vals);
+    pic_write_barrier(pic, vec, val);
+    vec->data[i] = val;
   }
 
   return pic_obj_value(vec);
@@ -251,9 +264,11 @@ pic_vec_vector_for_each(pic_state *pic)
 {
   struct pic_proc *proc;
   int argc, i, len, j;
-  pic_value *argv, vals;
+  pic_value *argv, *vals;
+  ptrdiff_t off;
 
   pic_get_args(pic, "l*", &proc, &argc, &argv);
+  off = argv - pic->ci->fp;
 
   len = INT_MAX;
   for (i = 0; i < argc; ++i) {
@@ -265,11 +280,12 @@ pic_vec_vector_for_each(pic_state *pic)
   }
 
   for (i = 0; i < len; ++i) {
-    vals = pic_nil_value();
+    vals = pic_apply_argv(pic, argc);
+    argv = pic->ci->fp + off;
     for (j = 0; j < argc; ++j) {
-      pic_push(pic, pic_vec_ptr(argv[j])->data[i], vals);
+      vals[j] = pic_vec_ptr(argv[j])->data[i];
     }
-    pic_apply_list(pic, proc, vals);
+    pic_apply(pic, proc, argc, vals);
   }
 
   return pic_undef_value();
@@ -383,12 +399,12 @@ pic_vec_string_to_vector(pic_state *pic)
 void
 pic_init_vector(pic_state *pic)
 {
-  pic_defun(pic, "vector?", pic_vec_vector_p);
+  pic_defun_spec(pic, "vector?", pic_vec_vector_p, "o");
   pic_defun(pic, "vector", pic_vec_vector);
   pic_defun(pic, "make-vector", pic_vec_make_vector);
-  pic_defun(pic, "vector-length", pic_vec_vector_length);
-  pic_defun(pic, "vector-ref", pic_vec_vector_ref);
-  pic_defun(pic, "vector-set!", pic_vec_vector_set);
+  pic_defun_spec(pic, "vector-length", pic_vec_vector_length, "v");
+  pic_defun_spec(pic, "vector-ref", pic_vec_vector_ref, "vi");
+  pic_defun_spec(pic, "vector-set!", pic_vec_vector_set, "vio");
   pic_defun(pic, "vector-copy!", pic_vec_vector_copy_i);
   pic_defun(pic, "vector-copy", pic_vec_vector_copy);
   pic_defun(pic, "vector-append", pic_vec_vector_append);
@@ -180,6 +180,60 @@ pic_get_args(pic_state *pic, const char *format, ...)
   return argc;
 }
 
+/**
+ * Checks the arguments of a call to a native made by pic_make_proc_spec,
+ * turning those given as i or f into an int or a float.
+ */
+static void
+vm_check_args(pic_state *pic, struct pic_argspec *spec)
+{
+  int i, n, argc = pic->ci->argc - 1;
+  pic_value *argv = pic->ci->fp + 1, v;
+  enum pic_tt tt;
+
+  if (argc < spec->req || (spec->req + spec->opt < argc && ! spec->rest)) {
+    pic_errorf(pic, "wrong number of arguments (%d for %s%d)", argc, spec->rest ? "at least " : "", spec->req);
+  }
+
+  n = spec->req + spec->opt < argc ? spec->req + spec->opt : argc;
+  for (i = 0; i < n; ++i) {
+    v = argv[i];
+    switch (spec->type[i]) {
+    case 'o':
+      continue;
+    case 'i':
+      if (pic_float_p(v)) {
+        argv[i] = pic_int_value((int)pic_float(v));
+      } else if (! pic_int_p(v)) {
+        pic_errorf(pic, "expected float or int, but got ~s", v);
+      }
+      continue;
+    case 'f':
+      if (pic_int_p(v)) {
+        argv[i] = pic_float_value(pic_int(v));
+      } else if (! pic_float_p(v)) {
+        pic_errorf(pic, "expected float or int, but got ~s", v);
+      }
+      continue;
+    case 'c': tt = PIC_TT_CHAR; break;
+    case 's': tt = PIC_TT_STRING; break;
+    case 'm': tt = PIC_TT_SYMBOL; break;
+    case 'v': tt = PIC_TT_VECTOR; break;
+    case 'b': tt = PIC_TT_BLOB; break;
+    case 'l': tt = PIC_TT_PROC; break;
+    case 'p': tt = PIC_TT_PORT; break;
+    case 'd': tt = PIC_TT_DICT; break;
+    case 'r': tt = PIC_TT_RECORD; break;
+    case 'e': tt = PIC_TT_ERROR; break;
+    default:
+      PIC_UNREACHABLE();
+    }
+    if (pic_type(v) != tt) {
+      pic_errorf(pic, "expected %s, but got ~s", pic_type_repr(tt), v);
+    }
+  }
+}
+
 struct pic_box *
 pic_vm_gref_slot(pic_state *pic, pic_sym *uid) /* TODO: make this static */
 {
@@ -205,60 +259,144 @@ vm_gref(pic_state *pic, struct pic_box *slot, pic_sym *uid)
   return slot->value;
 }
 
+static pic_value
+vm_lref(pic_state *pic, int i)
+{
+  return pic->ci->fp[i];
+}
+
+/** free variables are read from the closure at the bottom of the frame */
+static pic_value
+vm_cref(pic_state *pic, int i)
+{
+  return pic_proc_ptr(pic->ci->fp[0])->fv[i];
+}
+
 static void
-vm_gset(struct pic_box *slot, pic_value value)
+vm_gset(pic_state *pic, struct pic_box *slot, pic_value value)
 {
+  pic_write_barrier(pic, slot, value);
   slot->value = value;
 }
 
 static void
-vm_push_cxt(pic_state *pic)
+vm_setbox(pic_state *pic, struct pic_box *box, pic_value value)
 {
-  pic_callinfo *ci = pic->ci;
+  pic_write_barrier(pic, box, value);
+  box->value = value;
+}
+
+/** closes over the irep->freec values on top of the stack */
+static struct pic_proc *
+vm_lambda(pic_state *pic, struct pic_irep *irep)
+{
+  struct pic_proc *proc;
 
-  ci->cxt = (struct pic_context *)pic_obj_alloc(pic, sizeof(struct pic_context) + sizeof(pic_value) * ci->regc, PIC_TT_CXT);
-  ci->cxt->up = ci->up;
-  ci->cxt->regc = ci->regc;
-  ci->cxt->regs = ci->regs;
+  proc = pic_make_proc_irep(pic, irep, pic->sp - irep->freec);
+  pic->sp -= irep->freec;
+  return proc;
 }
 
-static void
-vm_tear_off(pic_callinfo *ci)
+/**
+ * Cons the n values at argv into a list in place. Each slot is left holding
+ * the tail that starts at it, so the pairs made so far stay reachable from
+ * the stack and none of them has to be protected.
+ */
+static pic_value
+vm_make_rest(pic_state *pic, pic_value *argv, int n)
 {
-  struct pic_context *cxt;
-  int i;
+  pic_value rest = pic_nil_value();
 
-  assert(ci->cxt != NULL);
+  while (n-- > 0) {
+    rest = pic_cons(pic, argv[n], rest);
+    argv[n] = rest;
+  }
+  return rest;
+}
 
-  cxt = ci->cxt;
+/**
+ * The slot of a lazy rest variable holds the number of extra arguments,
+ * which are kept just above the locals, until the list is asked for.
+ */
+static pic_value
+vm_lref_rest(pic_state *pic, int i)
+{
+  pic_callinfo *ci = pic->ci;
 
-  if (cxt->regs == cxt->storage) {
-    return;                     /* is torn off */
+  if (pic_int_p(ci->fp[i])) {
+    ci->fp[i] = vm_make_rest(pic, ci->fp + ci->irep->argc + ci->irep->localc, pic_int(ci->fp[i]));
   }
-  for (i = 0; i < cxt->regc; ++i) {
-    cxt->storage[i] = cxt->regs[i];
+  return ci->fp[i];
+}
+
+/**
+ * Monomorphic inline caches. Each call site remembers the procedure body it
+ * called last, provided that it takes exactly the arguments of the site and
+ * no rest list. On a hit the arity checks are known to pass and the frame is
+ * laid out directly; closures over the same lambda share a body and hit as
+ * well. Returns the callee on a hit, NULL when the generic path is needed.
+ */
+static bool
+vm_call_cache_fill(pic_state *pic, pic_code c, struct pic_irep *irep)
+{
+  if (irep->varg || irep->argc != c.u.i) {
+    return false;
   }
-  cxt->regs = cxt->storage;
+  pic_write_barrier(pic, pic->ci->irep, pic_obj_value(irep));
+  pic->ci->irep->cache[c.u.call.site] = irep;
+  return true;
 }
 
-void
-pic_vm_tear_off(pic_state *pic)
+PIC_INLINE struct pic_proc *
+vm_call_cache(pic_state *pic, pic_code c)
 {
-  pic_callinfo *ci;
+  pic_value x = pic->sp[-c.u.i];
+  struct pic_proc *proc;
 
-  for (ci = pic->ci; ci > pic->cibase; ci--) {
-    if (ci->cxt != NULL) {
-      vm_tear_off(ci);
+  if (c.u.call.site < 0 || pic_vtype(x) != PIC_VTYPE_HEAP) {
+    return NULL;
+  }
+  proc = pic_ptr(x);
+  if (proc->tt != PIC_TT_PROC || ! pic_proc_irep_p(proc)) {
+    return NULL;
+  }
+  if (pic->ci->irep->cache[c.u.call.site] != proc->u.i.irep) {
+    if (! vm_call_cache_fill(pic, c, proc->u.i.irep)) {
+      return NULL;
     }
   }
+  return proc;
 }
 
 #if VM_DEBUG
 # define OPCODE_EXEC_HOOK pic_dump_code(c)
+#elif VM_PROFILE
+/* a native frame only runs the boot code of pic_apply */
+# define OPCODE_EXEC_HOOK do {                                  \
+    pic->vmprof->ops[c.insn]++;                                 \
+    if (pic->ci->prof != NULL && pic->ci->prof->func == NULL) { \
+      pic->ci->prof->insns++;                                   \
+    }                                                           \
+  } while (0)
 #else
 # define OPCODE_EXEC_HOOK ((void)0)
 #endif
 
+#if VM_PROFILE
+# define VM_PROF_ENTER(ci, proc) pic_vm_prof_enter(pic, (ci), (proc))
+# define VM_PROF_LEAVE() pic_vm_prof_leave(pic, pic->ci)
+#else
+# define VM_PROF_ENTER(ci, proc) ((void)0)
+# define VM_PROF_LEAVE() ((void)0)
+#endif
+
+/** hands pending SIGPROF ticks to the sampling profiler */
+#define VM_SAMPLE_POLL() do {                   \
+    if (pic_prof_ticks) {                       \
+      pic_prof_tick(pic);                       \
+    }                                           \
+  } while (0)
+
 #if PIC_DIRECT_THREADED_VM
 # define VM_LOOP JUMP;
 # define CASE(x) L_##x: OPCODE_EXEC_HOOK;
@@ -266,19 +404,32 @@ pic_vm_tear_off(pic_state *pic)
 # define JUMP c = *pic->ip; goto *oplabels[c.insn];
 # define VM_LOOP_END
 #else
-# define VM_LOOP for (;;) { c = *pic->ip; switch (c.insn) {
+# define VM_LOOP for (;;) { c = *pic->ip; OPCODE_EXEC_HOOK; switch (c.insn) {
 # define CASE(x) case x:
 # define NEXT pic->ip++; break
 # define JUMP break
 # define VM_LOOP_END } }
 #endif
 
-#define PUSH(v) (*pic->sp++ = (v))
+#define PUSH(v) (*pic->sp = (v), pic->sp++)
 #define POP() (*--pic->sp)
 
-#define PUSHCI() (++pic->ci)
+#define PUSHCI() (pic->ci + 1 < pic->ciend ? ++pic->ci : vm_push_ci(pic))
 #define POPCI() (pic->ci--)
 
+#if PIC_JIT
+# define VM_JIT_ENTER(irep) do {                                        \
+    if ((irep)->calls < PIC_JIT_THRESHOLD && ++(irep)->calls == PIC_JIT_THRESHOLD) { \
+      pic_jit_compile(pic, (irep));                                     \
+    }                                                                   \
+    if ((irep)->jit != NULL) {                                          \
+      pic_jit_enter(pic, (irep), pic->ip);                              \
+    }                                                                   \
+  } while (0)
+#else
+# define VM_JIT_ENTER(irep) ((void)0)
+#endif
+
 #if VM_DEBUG
 # define VM_BOOT_PRINT                          \
   do {                                          \
@@ -342,6 +493,96 @@ pic_vm_tear_off(pic_state *pic)
 # define VM_CALL_PRINT
 #endif
 
+/** the room handlers get to run in once the stack has overflowed */
+#define VM_STACK_HEADROOM 1024
+
+#define VM_RESERVE(n, argv) do {                \
+    if (pic->sp + (n) >= pic->stend) {          \
+      pic_vm_grow_stack(pic, (n), (argv));      \
+    }                                           \
+  } while (0)
+
+static void
+vm_realloc_stack(pic_state *pic, size_t len)
+{
+  pic_value *stbase;
+  pic_callinfo *ci;
+
+  stbase = pic_malloc(pic, sizeof(pic_value) * len);
+  memcpy(stbase, pic->stbase, sizeof(pic_value) * (pic->stend - pic->stbase));
+
+  for (ci = pic->cibase; ci <= pic->ci; ++ci) {
+    ci->fp = stbase + (ci->fp - pic->stbase);
+  }
+  pic->sp = stbase + (pic->sp - pic->stbase);
+  pic->stend = stbase + len;
+
+  pic_free(pic, pic->stbase);
+  pic->stbase = stbase;
+}
+
+/**
+ * The value stack starts at PIC_STACK_SIZE slots and doubles whenever
+ * a frame needs more room than is left, up to PIC_STACK_MAX. Past the
+ * cap a "stack overflow" error is raised; the stack is extended by a
+ * little headroom first so that the handlers have somewhere to run,
+ * and pic_vm_reclaim_headroom takes it back once the error unwinds
+ * below the cap. Overflowing the headroom itself is fatal.
+ *
+ * Every frame pointer is rebased, and so is *argv when it points into
+ * the stack, but a native must not keep pointers into its own frame
+ * across a call to a procedure that may push.
+ */
+void
+pic_vm_grow_stack(pic_state *pic, size_t n, pic_value **argv)
+{
+  size_t used = pic->sp - pic->stbase, len = pic->stend - pic->stbase;
+  ptrdiff_t off = 0;
+  bool rebase;
+
+  rebase = argv != NULL && pic->stbase <= *argv && *argv < pic->stend;
+  if (rebase) {
+    off = *argv - pic->stbase;
+  }
+
+  if (used + n < PIC_STACK_MAX) {
+    while (used + n >= len) {
+      len *= 2;
+    }
+    vm_realloc_stack(pic, len < PIC_STACK_MAX ? len : PIC_STACK_MAX);
+    if (rebase) {
+      *argv = pic->stbase + off;
+    }
+    return;
+  }
+
+  if (len > PIC_STACK_MAX) {
+    pic_panic(pic, "VM stack overflow");
+  }
+  vm_realloc_stack(pic, PIC_STACK_MAX + VM_STACK_HEADROOM);
+  pic_errorf(pic, "stack overflow");
+}
+
+/* takes back the headroom lent after a stack overflow, once the stack is below the cap again */
+void
+pic_vm_reclaim_headroom(pic_state *pic)
+{
+  if (pic->stend - pic->stbase > PIC_STACK_MAX && pic->sp - pic->stbase < PIC_STACK_MAX) {
+    pic->stend = pic->stbase + PIC_STACK_MAX;
+  }
+}
+
+static pic_callinfo *
+vm_push_ci(pic_state *pic)
+{
+  size_t len = pic->ciend - pic->cibase, off = pic->ci - pic->cibase;
+
+  pic->cibase = pic_realloc(pic, pic->cibase, sizeof(pic_callinfo) * len * 2);
+  pic->ci = pic->cibase + off + 1;
+  pic->ciend = pic->cibase + len * 2;
+  return pic->ci;
+}
+
 pic_value
 pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
 {
@@ -354,12 +595,20 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
   static const void *oplabels[] = {
     &&L_OP_NOP, &&L_OP_POP, &&L_OP_PUSHUNDEF, &&L_OP_PUSHNIL, &&L_OP_PUSHTRUE,
     &&L_OP_PUSHFALSE, &&L_OP_PUSHINT, &&L_OP_PUSHCHAR, &&L_OP_PUSHCONST,
-    &&L_OP_GREF, &&L_OP_GSET, &&L_OP_LREF, &&L_OP_LSET, &&L_OP_CREF, &&L_OP_CSET,
+    &&L_OP_GREF, &&L_OP_GSET, &&L_OP_LREF, &&L_OP_LSET, &&L_OP_CREF,
+    &&L_OP_BOX, &&L_OP_UNBOX, &&L_OP_SETBOX,
     &&L_OP_JMP, &&L_OP_JMPIF, &&L_OP_NOT, &&L_OP_CALL, &&L_OP_TAILCALL, &&L_OP_RET,
     &&L_OP_LAMBDA, &&L_OP_CONS, &&L_OP_CAR, &&L_OP_CDR, &&L_OP_NILP,
     &&L_OP_SYMBOLP, &&L_OP_PAIRP,
     &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL, &&L_OP_DIV,
-    &&L_OP_EQ, &&L_OP_LT, &&L_OP_LE, &&L_OP_GT, &&L_OP_GE, &&L_OP_STOP
+    &&L_OP_EQ, &&L_OP_LT, &&L_OP_LE, &&L_OP_GT, &&L_OP_GE,
+    &&L_OP_LREFCAR, &&L_OP_LREFCDR, &&L_OP_LREFNILPJMPIF, &&L_OP_LREFADDI,
+    &&L_OP_LREFSUBI, &&L_OP_RESTNILP, &&L_OP_RESTPAIRP, &&L_OP_RESTCAR,
+    &&L_OP_LREFREST, &&L_OP_APPLYREST,
+    &&L_OP_RCONS, &&L_OP_RCAR, &&L_OP_RCDR, &&L_OP_RNILP, &&L_OP_RSYMBOLP,
+    &&L_OP_RPAIRP, &&L_OP_RNOT,
+    &&L_OP_RADD, &&L_OP_RSUB, &&L_OP_RMUL, &&L_OP_RDIV,
+    &&L_OP_REQ, &&L_OP_RLT, &&L_OP_RLE, &&L_OP_RGT, &&L_OP_RGE, &&L_OP_STOP
   };
 #endif
 
@@ -368,6 +617,8 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
   pic_callinfo *cibase;
 #endif
 
+  VM_RESERVE(argc + 1, &argv);
+
   PUSH(pic_obj_value(proc));
 
   for (i = 0; i < argc; ++i) {
@@ -378,7 +629,8 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
 
   /* boot! */
   boot[0].insn = OP_CALL;
-  boot[0].u.i = argc + 1;
+  boot[0].u.call.argc = argc + 1;
+  boot[0].u.call.site = -1;
   boot[1].insn = OP_STOP;
   pic->ip = boot;
 
@@ -423,62 +675,44 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
       NEXT;
     }
     CASE(OP_GSET) {
-      vm_gset(pic_box_ptr(pic->ci->irep->pool[c.u.i]), POP());
+      vm_gset(pic, pic_box_ptr(pic->ci->irep->pool[c.u.i]), POP());
       PUSH(pic_undef_value());
       NEXT;
     }
     CASE(OP_LREF) {
-      pic_callinfo *ci = pic->ci;
-      struct pic_irep *irep = ci->irep;
-
-      if (ci->cxt != NULL && ci->cxt->regs == ci->cxt->storage) {
-        if (c.u.i >= irep->argc + irep->localc) {
-          PUSH(ci->cxt->regs[c.u.i - (ci->regs - ci->fp)]);
-          NEXT;
-        }
-      }
-      PUSH(pic->ci->fp[c.u.i]);
+      PUSH(vm_lref(pic, c.u.i));
       NEXT;
     }
     CASE(OP_LSET) {
-      pic_callinfo *ci = pic->ci;
-      struct pic_irep *irep = ci->irep;
-
-      if (ci->cxt != NULL && ci->cxt->regs == ci->cxt->storage) {
-        if (c.u.i >= irep->argc + irep->localc) {
-          ci->cxt->regs[c.u.i - (ci->regs - ci->fp)] = POP();
-          PUSH(pic_undef_value());
-          NEXT;
-        }
-      }
       pic->ci->fp[c.u.i] = POP();
       PUSH(pic_undef_value());
       NEXT;
     }
     CASE(OP_CREF) {
-      int depth = c.u.r.depth;
-      struct pic_context *cxt;
-
-      cxt = pic->ci->up;
-      while (--depth) {
-	cxt = cxt->up;
-      }
-      PUSH(cxt->regs[c.u.r.idx]);
+      PUSH(vm_cref(pic, c.u.i));
+      NEXT;
+    }
+    CASE(OP_BOX) {
+      pic->ci->fp[c.u.i] = pic_obj_value(pic_box(pic, pic->ci->fp[c.u.i]));
+      pic_gc_arena_restore(pic, ai);
+      NEXT;
+    }
+    CASE(OP_UNBOX) {
+      pic->sp[-1] = pic_box_ptr(pic->sp[-1])->value;
       NEXT;
     }
-    CASE(OP_CSET) {
-      int depth = c.u.r.depth;
-      struct pic_context *cxt;
+    CASE(OP_SETBOX) {
+      struct pic_box *box;
 
-      cxt = pic->ci->up;
-      while (--depth) {
-	cxt = cxt->up;
-      }
-      cxt->regs[c.u.r.idx] = POP();
+      box = pic_box_ptr(POP());
+      vm_setbox(pic, box, POP());
       PUSH(pic_undef_value());
       NEXT;
     }
     CASE(OP_JMP) {
+      if (c.u.i < 0) {
+        VM_SAMPLE_POLL();
+      }
       pic->ip += c.u.i;
       JUMP;
     }
@@ -500,6 +734,32 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
         pic->sp += pic->ci[1].retc - 1;
         c.u.i = pic->ci[1].retc + 1;
       }
+      if ((proc = vm_call_cache(pic, c)) == NULL) {
+        goto L_CALL;
+      }
+
+    L_ENTER: {
+        struct pic_irep *irep = proc->u.i.irep;
+
+        VM_CALL_PRINT;
+
+        VM_RESERVE(irep->stackc, NULL);
+
+        ci = PUSHCI();
+        ci->argc = c.u.i;
+        ci->retc = 1;
+        ci->ip = pic->ip;
+        ci->fp = pic->sp - c.u.i;
+        ci->irep = irep;
+        VM_PROF_ENTER(ci, proc);
+        for (i = 0; i < irep->localc; ++i) {
+          PUSH(pic_undef_value());
+        }
+        VM_SAMPLE_POLL();
+        pic->ip = irep->code;
+        VM_JIT_ENTER(irep);
+        JUMP;
+      }
 
     L_CALL:
       x = pic->sp[-c.u.i];
@@ -510,9 +770,8 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
 
       VM_CALL_PRINT;
 
-      if (pic->sp >= pic->stend) {
-        pic_panic(pic, "VM stack overflow");
-      }
+      /* a native may put as many values as it got arguments */
+      VM_RESERVE(pic_proc_func_p(proc) ? c.u.i : proc->u.i.irep->stackc, NULL);
 
       ci = PUSHCI();
       ci->argc = c.u.i;
@@ -520,8 +779,13 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
       ci->ip = pic->ip;
       ci->fp = pic->sp - c.u.i;
       ci->irep = NULL;
-      ci->cxt = NULL;
+      VM_PROF_ENTER(ci, proc);
       if (pic_proc_func_p(proc)) {
+        VM_SAMPLE_POLL();
+
+        if (proc->u.f.spec != NULL) {
+          vm_check_args(pic, proc->u.f.spec);
+        }
 
         /* invoke! */
         v = proc->u.f.func(pic);
@@ -543,32 +807,41 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
 	  }
 	}
 	/* prepare rest args */
-	if (irep->varg) {
-	  rest = pic_nil_value();
-	  for (i = 0; i < ci->argc - irep->argc; ++i) {
-	    pic_gc_protect(pic, v = POP());
-	    rest = pic_cons(pic, v, rest);
+	if (irep->lazyrest) {
+	  int n = ci->argc - irep->argc;
+
+	  /* move the extra arguments above the locals */
+	  for (i = n - 1; i >= 0; --i) {
+	    ci->fp[irep->argc + irep->localc + i] = ci->fp[irep->argc + i];
 	  }
-	  PUSH(rest);
+	  ci->fp[irep->argc] = pic_int_value(n);
+	  for (i = 1; i < irep->localc; ++i) {
+	    ci->fp[irep->argc + i] = pic_undef_value();
+	  }
+	  pic->sp = ci->fp + irep->argc + irep->localc + n;
 	}
-	/* prepare local variable area */
-	if (irep->localc > 0) {
-	  int l = irep->localc;
+	else {
 	  if (irep->varg) {
-	    --l;
+	    rest = vm_make_rest(pic, ci->fp + irep->argc, ci->argc - irep->argc);
+	    pic->sp = ci->fp + irep->argc;
+	    PUSH(rest);
 	  }
-	  for (i = 0; i < l; ++i) {
-	    PUSH(pic_undef_value());
+	  /* prepare local variable area */
+	  if (irep->localc > 0) {
+	    int l = irep->localc;
+	    if (irep->varg) {
+	      --l;
+	    }
+	    for (i = 0; i < l; ++i) {
+	      PUSH(pic_undef_value());
+	    }
 	  }
 	}
-
-	/* prepare cxt */
-        ci->up = proc->u.i.cxt;
-        ci->regc = irep->capturec;
-        ci->regs = ci->fp + irep->argc + irep->localc;
+        VM_SAMPLE_POLL();
 
 	pic->ip = irep->code;
 	pic_gc_arena_restore(pic, ai);
+        VM_JIT_ENTER(irep);
 	JUMP;
       }
     }
@@ -577,25 +850,27 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
       pic_value *argv;
       pic_callinfo *ci;
 
-      if (pic->ci->cxt != NULL) {
-        vm_tear_off(pic->ci);
-      }
-
       if (c.u.i == -1) {
         pic->sp += pic->ci[1].retc - 1;
         c.u.i = pic->ci[1].retc + 1;
       }
+    L_TAILCALL:
+      proc = vm_call_cache(pic, c);
 
       argc = c.u.i;
       argv = pic->sp - argc;
       for (i = 0; i < argc; ++i) {
 	pic->ci->fp[i] = argv[i];
       }
+      VM_PROF_LEAVE();
       ci = POPCI();
       pic->sp = ci->fp + argc;
       pic->ip = ci->ip;
 
       /* c is not changed */
+      if (proc != NULL) {
+        goto L_ENTER;
+      }
       goto L_CALL;
     }
     CASE(OP_RET) {
@@ -603,10 +878,6 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
       pic_value *retv;
       pic_callinfo *ci;
 
-      if (pic->ci->cxt != NULL) {
-        vm_tear_off(pic->ci);
-      }
-
       assert(pic->ci->retc == 1);
 
     L_RET:
@@ -618,18 +889,28 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
       for (i = 0; i < retc; ++i) {
         pic->ci->fp[i] = retv[i];
       }
+      VM_PROF_LEAVE();
       ci = POPCI();
       pic->sp = ci->fp + 1;     /* advance only one! */
       pic->ip = ci->ip;
 
+#if PIC_JIT
+      /* resume a translated caller in native code */
+      if (pic->ci->irep != NULL && pic->ci->irep->jit != NULL) {
+        struct pic_irep *irep = pic->ci->irep;
+
+        if (irep->code <= pic->ip && pic->ip < irep->code + irep->clen) {
+          pic->ip++;
+          pic_jit_enter(pic, irep, pic->ip);
+          JUMP;
+        }
+      }
+#endif
+
       NEXT;
     }
     CASE(OP_LAMBDA) {
-      if (pic->ci->cxt == NULL) {
-        vm_push_cxt(pic);
-      }
-
-      proc = pic_make_proc_irep(pic, pic->ci->irep->irep[c.u.i], pic->ci->cxt);
+      proc = vm_lambda(pic, pic->ci->irep->irep[c.u.i]);
       PUSH(pic_obj_value(proc));
       pic_gc_arena_restore(pic, ai);
       NEXT;
@@ -748,7 +1029,7 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
     }
     CASE(OP_LE) {
       pic_value a, b;
-      check_condition(LT, 2);
+      check_condition(LE, 2);
       b = POP();
       a = POP();
       (void)POP();
@@ -757,7 +1038,7 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
     }
     CASE(OP_LT) {
       pic_value a, b;
-      check_condition(LE, 2);
+      check_condition(LT, 2);
       b = POP();
       a = POP();
       (void)POP();
@@ -766,7 +1047,7 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
     }
     CASE(OP_GE) {
       pic_value a, b;
-      check_condition(LT, 2);
+      check_condition(GE, 2);
       b = POP();
       a = POP();
       (void)POP();
@@ -775,7 +1056,7 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
     }
     CASE(OP_GT) {
       pic_value a, b;
-      check_condition(LE, 2);
+      check_condition(GT, 2);
       b = POP();
       a = POP();
       (void)POP();
@@ -783,6 +1064,179 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
       NEXT;
     }
 
+    /* superinstructions replace the OP_GREF of the primitive and are
+       followed by the rest of their original sequence, which runs as
+       usual once the primitive is redefined */
+#define check_super(name)                                               \
+    if (! pic_eq_p(pic->p##name, pic->c##name->value)) {                \
+      PUSH(vm_gref(pic, pic_box_ptr(pic->ci->irep->pool[c.u.i]), NULL)); \
+      NEXT;                                                             \
+    }
+
+    CASE(OP_LREFCAR) {
+      check_super(CAR);
+      PUSH(pic_car(pic, vm_lref(pic, pic->ip[1].u.i)));
+      pic->ip += 3;
+      JUMP;
+    }
+    CASE(OP_LREFCDR) {
+      check_super(CDR);
+      PUSH(pic_cdr(pic, vm_lref(pic, pic->ip[1].u.i)));
+      pic->ip += 3;
+      JUMP;
+    }
+    CASE(OP_LREFNILPJMPIF) {
+      check_super(NILP);
+      if (pic_nil_p(vm_lref(pic, pic->ip[1].u.i))) {
+        pic->ip += 3 + pic->ip[3].u.i;
+      } else {
+        pic->ip += 4;
+      }
+      JUMP;
+    }
+    CASE(OP_LREFADDI) {
+      check_super(ADD);
+      PUSH(pic_add(pic, vm_lref(pic, pic->ip[1].u.i), pic_int_value(pic->ip[2].u.i)));
+      pic->ip += 4;
+      JUMP;
+    }
+    CASE(OP_LREFSUBI) {
+      check_super(SUB);
+      PUSH(pic_sub(pic, vm_lref(pic, pic->ip[1].u.i), pic_int_value(pic->ip[2].u.i)));
+      pic->ip += 4;
+      JUMP;
+    }
+
+    /* a lazy rest variable answers from the extra arguments on the stack
+       as long as the list has not been made */
+#define vm_rest_count(i) (pic_int_p(pic->ci->fp[i]) ? pic_int(pic->ci->fp[i]) : -1)
+#define vm_rest_argv() (pic->ci->fp + pic->ci->irep->argc + pic->ci->irep->localc)
+
+    CASE(OP_RESTNILP) {
+      int n;
+
+      check_super(NILP);
+      n = vm_rest_count(pic->ip[1].u.i);
+      PUSH(pic_bool_value(n < 0 ? pic_nil_p(vm_lref(pic, pic->ip[1].u.i)) : n == 0));
+      pic->ip += 3;
+      JUMP;
+    }
+    CASE(OP_RESTPAIRP) {
+      int n;
+
+      check_super(PAIRP);
+      n = vm_rest_count(pic->ip[1].u.i);
+      PUSH(pic_bool_value(n < 0 ? pic_pair_p(vm_lref(pic, pic->ip[1].u.i)) : n > 0));
+      pic->ip += 3;
+      JUMP;
+    }
+    CASE(OP_RESTCAR) {
+      int n;
+
+      check_super(CAR);
+      n = vm_rest_count(pic->ip[1].u.i);
+      PUSH(n > 0 ? vm_rest_argv()[0] : pic_car(pic, vm_lref_rest(pic, pic->ip[1].u.i)));
+      pic->ip += 3;
+      JUMP;
+    }
+    CASE(OP_LREFREST) {
+      PUSH(vm_lref_rest(pic, c.u.i));
+      pic_gc_arena_restore(pic, ai);
+      NEXT;
+    }
+    CASE(OP_APPLYREST) {
+      pic_value *argv;
+      int i, n, slot = pic->ci->irep->argc, tail = c.u.o.b;
+
+      /* (apply f a ... rest) with the values of apply, f and a ... pushed */
+      n = vm_rest_count(slot);
+      if (n < 0 || ! pic_eq_p(pic->sp[-c.u.o.a], pic->pAPPLY) || ! pic_eq_p(pic->pAPPLY, pic->cAPPLY->value)) {
+        PUSH(vm_lref_rest(pic, slot));
+        pic_gc_arena_restore(pic, ai);
+        c.u.call.argc = c.u.o.a + 1;
+        c.u.call.site = -1;
+      }
+      else {
+        VM_RESERVE(n, NULL);
+        argv = pic->sp - c.u.o.a;
+        for (i = 0; i < c.u.o.a - 1; ++i) {
+          argv[i] = argv[i + 1];
+        }
+        (void)POP();
+        argv = vm_rest_argv();
+        for (i = 0; i < n; ++i) {
+          PUSH(argv[i]);
+        }
+        c.u.call.argc = c.u.o.a - 1 + n;
+        c.u.call.site = -1;
+      }
+      if (tail) {
+        goto L_TAILCALL;
+      }
+      goto L_CALL;
+    }
+#undef vm_rest_count
+#undef vm_rest_argv
+
+    /* register instructions call the primitive as a procedure once it is
+       redefined, after pushing what the stack code would have pushed */
+#define vm_operand(x) ((x) >= 0 ? vm_lref(pic, (x)) : pic->ci->irep->pool[-(x) - 1])
+
+#define check_register(name, n)                                         \
+    if (! pic_eq_p(pic->p##name, pic->c##name->value)) {                \
+      PUSH(vm_gref(pic, pic->c##name, NULL));                           \
+      PUSH(vm_operand(c.u.o.a));                                        \
+      if (n == 2) {                                                     \
+        PUSH(vm_operand(c.u.o.b));                                      \
+      }                                                                 \
+      c.u.i = n + 1;                                                    \
+      goto L_CALL;                                                      \
+    }
+
+#define vm_register1(name, expr)                                        \
+    CASE(OP_R##name) {                                                  \
+      pic_value a;                                                      \
+      check_register(name, 1);                                          \
+      a = vm_operand(c.u.o.a);                                          \
+      PUSH(expr);                                                       \
+      NEXT;                                                             \
+    }
+
+#define vm_register2(name, expr)                                        \
+    CASE(OP_R##name) {                                                  \
+      pic_value a, b;                                                   \
+      check_register(name, 2);                                          \
+      a = vm_operand(c.u.o.a);                                          \
+      b = vm_operand(c.u.o.b);                                          \
+      PUSH(expr);                                                       \
+      NEXT;                                                             \
+    }
+
+    CASE(OP_RCONS) {
+      pic_value a, b;
+      check_register(CONS, 2);
+      a = vm_operand(c.u.o.a);
+      b = vm_operand(c.u.o.b);
+      PUSH(pic_cons(pic, a, b));
+      pic_gc_arena_restore(pic, ai);
+      NEXT;
+    }
+    vm_register1(CAR, pic_car(pic, a))
+    vm_register1(CDR, pic_cdr(pic, a))
+    vm_register1(NILP, pic_bool_value(pic_nil_p(a)))
+    vm_register1(SYMBOLP, pic_bool_value(pic_sym_p(a)))
+    vm_register1(PAIRP, pic_bool_value(pic_pair_p(a)))
+    vm_register1(NOT, pic_bool_value(pic_false_p(a)))
+    vm_register2(ADD, pic_add(pic, a, b))
+    vm_register2(SUB, pic_sub(pic, a, b))
+    vm_register2(MUL, pic_mul(pic, a, b))
+    vm_register2(DIV, pic_div(pic, a, b))
+    vm_register2(EQ, pic_bool_value(pic_eq(pic, a, b)))
+    vm_register2(LT, pic_bool_value(pic_lt(pic, a, b)))
+    vm_register2(LE, pic_bool_value(pic_le(pic, a, b)))
+    vm_register2(GT, pic_bool_value(pic_gt(pic, a, b)))
+    vm_register2(GE, pic_bool_value(pic_ge(pic, a, b)))
+
     CASE(OP_STOP) {
 
       VM_END_PRINT;
@@ -792,22 +1246,363 @@ pic_apply(pic_state *pic, struct pic_proc *proc, int argc, pic_value *argv)
   } VM_LOOP_END;
 }
 
-pic_value
-pic_apply_list(pic_state *pic, struct pic_proc *proc, pic_value list)
+#if PIC_JIT
+
+/**
+ * Helpers called from native code, one per instruction the JIT does not
+ * inline. Each runs the instruction at ip with the same stack effect as
+ * the interpreter and returns zero, or returns non-zero without touching
+ * anything when the interpreter must run the instruction instead (a
+ * primitive has been redefined, or it is called with unusual arity).
+ */
+
+#define jit_check(name, n)                                              \
+  if (! pic_eq_p(pic->p##name, pic->c##name->value) || ip->u.i != n + 1) \
+    return 1
+
+#define jit_check_bound(name)                                           \
+  if (! pic_eq_p(pic->p##name, pic->c##name->value))                    \
+    return 1
+
+#define jit_operand(x) ((x) >= 0 ? vm_lref(pic, (x)) : pic->ci->irep->pool[-(x) - 1])
+
+static int
+jit_pushconst(pic_state *pic, pic_code *ip)
 {
-  int n, i = 0;
-  pic_vec *args;
-  pic_value x, it;
+  PUSH(pic->ci->irep->pool[ip->u.i]);
+  return 0;
+}
 
-  n = pic_length(pic, list);
+static int
+jit_gref(pic_state *pic, pic_code *ip)
+{
+  PUSH(vm_gref(pic, pic_box_ptr(pic->ci->irep->pool[ip->u.i]), NULL));
+  return 0;
+}
 
-  args = pic_make_vec(pic, n);
+static int
+jit_gset(pic_state *pic, pic_code *ip)
+{
+  vm_gset(pic, pic_box_ptr(pic->ci->irep->pool[ip->u.i]), POP());
+  PUSH(pic_undef_value());
+  return 0;
+}
+
+static int
+jit_lref(pic_state *pic, pic_code *ip)
+{
+  PUSH(vm_lref(pic, ip->u.i));
+  return 0;
+}
+
+static int
+jit_lset(pic_state *pic, pic_code *ip)
+{
+  pic->ci->fp[ip->u.i] = POP();
+  PUSH(pic_undef_value());
+  return 0;
+}
+
+static int
+jit_cref(pic_state *pic, pic_code *ip)
+{
+  PUSH(vm_cref(pic, ip->u.i));
+  return 0;
+}
+
+static int
+jit_box(pic_state *pic, pic_code *ip)
+{
+  size_t ai = pic_gc_arena_preserve(pic);
+
+  pic->ci->fp[ip->u.i] = pic_obj_value(pic_box(pic, pic->ci->fp[ip->u.i]));
+  pic_gc_arena_restore(pic, ai);
+  return 0;
+}
+
+static int
+jit_unbox(pic_state *pic, pic_code *ip)
+{
+  (void)ip;
+
+  pic->sp[-1] = pic_box_ptr(pic->sp[-1])->value;
+  return 0;
+}
+
+static int
+jit_setbox(pic_state *pic, pic_code *ip)
+{
+  struct pic_box *box;
+
+  (void)ip;
+
+  box = pic_box_ptr(POP());
+  vm_setbox(pic, box, POP());
+  PUSH(pic_undef_value());
+  return 0;
+}
+
+static int
+jit_lambda(pic_state *pic, pic_code *ip)
+{
+  size_t ai = pic_gc_arena_preserve(pic);
+  struct pic_proc *proc;
+
+  proc = vm_lambda(pic, pic->ci->irep->irep[ip->u.i]);
+  PUSH(pic_obj_value(proc));
+  pic_gc_arena_restore(pic, ai);
+  return 0;
+}
+
+static int
+jit_cons(pic_state *pic, pic_code *ip)
+{
+  size_t ai = pic_gc_arena_preserve(pic);
+  pic_value a, b;
+
+  jit_check(CONS, 2);
+  pic_gc_protect(pic, b = POP());
+  pic_gc_protect(pic, a = POP());
+  (void)POP();
+  PUSH(pic_cons(pic, a, b));
+  pic_gc_arena_restore(pic, ai);
+  return 0;
+}
+
+#define jit_stack1(name, check, expr)                                   \
+  static int                                                            \
+  jit_##name(pic_state *pic, pic_code *ip)                              \
+  {                                                                     \
+    pic_value a;                                                        \
+    jit_check(check, 1);                                                \
+    a = POP();                                                          \
+    (void)POP();                                                        \
+    PUSH(expr);                                                         \
+    return 0;                                                           \
+  }
+
+#define jit_stack2(name, check, expr)                                   \
+  static int                                                            \
+  jit_##name(pic_state *pic, pic_code *ip)                              \
+  {                                                                     \
+    pic_value a, b;                                                     \
+    jit_check(check, 2);                                                \
+    b = POP();                                                          \
+    a = POP();                                                          \
+    (void)POP();                                                        \
+    PUSH(expr);                                                         \
+    return 0;                                                           \
+  }
+
+jit_stack1(car, CAR, pic_car(pic, a))
+jit_stack1(cdr, CDR, pic_cdr(pic, a))
+jit_stack1(nilp, NILP, pic_bool_value(pic_nil_p(a)))
+jit_stack1(symbolp, SYMBOLP, pic_bool_value(pic_sym_p(a)))
+jit_stack1(pairp, PAIRP, pic_bool_value(pic_pair_p(a)))
+jit_stack1(not, NOT, pic_bool_value(pic_false_p(a)))
+jit_stack2(add, ADD, pic_add(pic, a, b))
+jit_stack2(sub, SUB, pic_sub(pic, a, b))
+jit_stack2(mul, MUL, pic_mul(pic, a, b))
+jit_stack2(div, DIV, pic_div(pic, a, b))
+jit_stack2(eq, EQ, pic_bool_value(pic_eq(pic, a, b)))
+jit_stack2(lt, LT, pic_bool_value(pic_lt(pic, a, b)))
+jit_stack2(le, LE, pic_bool_value(pic_le(pic, a, b)))
+jit_stack2(gt, GT, pic_bool_value(pic_gt(pic, a, b)))
+jit_stack2(ge, GE, pic_bool_value(pic_ge(pic, a, b)))
+
+static int
+jit_lrefcar(pic_state *pic, pic_code *ip)
+{
+  jit_check_bound(CAR);
+  PUSH(pic_car(pic, vm_lref(pic, ip[1].u.i)));
+  return 0;
+}
+
+static int
+jit_lrefcdr(pic_state *pic, pic_code *ip)
+{
+  jit_check_bound(CDR);
+  PUSH(pic_cdr(pic, vm_lref(pic, ip[1].u.i)));
+  return 0;
+}
+
+/* 0 falls through, 2 takes the branch of the trailing OP_JMPIF */
+static int
+jit_lrefnilpjmpif(pic_state *pic, pic_code *ip)
+{
+  jit_check_bound(NILP);
+  return pic_nil_p(vm_lref(pic, ip[1].u.i)) ? 2 : 0;
+}
+
+static int
+jit_lrefaddi(pic_state *pic, pic_code *ip)
+{
+  jit_check_bound(ADD);
+  PUSH(pic_add(pic, vm_lref(pic, ip[1].u.i), pic_int_value(ip[2].u.i)));
+  return 0;
+}
+
+static int
+jit_lrefsubi(pic_state *pic, pic_code *ip)
+{
+  jit_check_bound(SUB);
+  PUSH(pic_sub(pic, vm_lref(pic, ip[1].u.i), pic_int_value(ip[2].u.i)));
+  return 0;
+}
+
+static int
+jit_rcons(pic_state *pic, pic_code *ip)
+{
+  size_t ai = pic_gc_arena_preserve(pic);
+  pic_value a, b;
+
+  jit_check_bound(CONS);
+  a = jit_operand(ip->u.o.a);
+  b = jit_operand(ip->u.o.b);
+  PUSH(pic_cons(pic, a, b));
+  pic_gc_arena_restore(pic, ai);
+  return 0;
+}
+
+#define jit_register1(name, check, expr)                                \
+  static int                                                            \
+  jit_r##name(pic_state *pic, pic_code *ip)                             \
+  {                                                                     \
+    pic_value a;                                                        \
+    jit_check_bound(check);                                          \
+    a = jit_operand(ip->u.o.a);                                         \
+    PUSH(expr);                                                         \
+    return 0;                                                           \
+  }
+
+#define jit_register2(name, check, expr)                                \
+  static int                                                            \
+  jit_r##name(pic_state *pic, pic_code *ip)                             \
+  {                                                                     \
+    pic_value a, b;                                                     \
+    jit_check_bound(check);                                          \
+    a = jit_operand(ip->u.o.a);                                         \
+    b = jit_operand(ip->u.o.b);                                         \
+    PUSH(expr);                                                         \
+    return 0;                                                           \
+  }
+
+jit_register1(car, CAR, pic_car(pic, a))
+jit_register1(cdr, CDR, pic_cdr(pic, a))
+jit_register1(nilp, NILP, pic_bool_value(pic_nil_p(a)))
+jit_register1(symbolp, SYMBOLP, pic_bool_value(pic_sym_p(a)))
+jit_register1(pairp, PAIRP, pic_bool_value(pic_pair_p(a)))
+jit_register1(not, NOT, pic_bool_value(pic_false_p(a)))
+jit_register2(add, ADD, pic_add(pic, a, b))
+jit_register2(sub, SUB, pic_sub(pic, a, b))
+jit_register2(mul, MUL, pic_mul(pic, a, b))
+jit_register2(div, DIV, pic_div(pic, a, b))
+jit_register2(eq, EQ, pic_bool_value(pic_eq(pic, a, b)))
+jit_register2(lt, LT, pic_bool_value(pic_lt(pic, a, b)))
+jit_register2(le, LE, pic_bool_value(pic_le(pic, a, b)))
+jit_register2(gt, GT, pic_bool_value(pic_gt(pic, a, b)))
+jit_register2(ge, GE, pic_bool_value(pic_ge(pic, a, b)))
+
+pic_jit_helper
+pic_vm_jit_helper(int insn)
+{
+  switch (insn) {
+  case OP_PUSHCONST: return jit_pushconst;
+  case OP_GREF: return jit_gref;
+  case OP_GSET: return jit_gset;
+  case OP_LREF: return jit_lref;
+  case OP_LSET: return jit_lset;
+  case OP_CREF: return jit_cref;
+  case OP_BOX: return jit_box;
+  case OP_UNBOX: return jit_unbox;
+  case OP_SETBOX: return jit_setbox;
+  case OP_LAMBDA: return jit_lambda;
+  case OP_CONS: return jit_cons;
+  case OP_CAR: return jit_car;
+  case OP_CDR: return jit_cdr;
+  case OP_NILP: return jit_nilp;
+  case OP_SYMBOLP: return jit_symbolp;
+  case OP_PAIRP: return jit_pairp;
+  case OP_NOT: return jit_not;
+  case OP_ADD: return jit_add;
+  case OP_SUB: return jit_sub;
+  case OP_MUL: return jit_mul;
+  case OP_DIV: return jit_div;
+  case OP_EQ: return jit_eq;
+  case OP_LT: return jit_lt;
+  case OP_LE: return jit_le;
+  case OP_GT: return jit_gt;
+  case OP_GE: return jit_ge;
+  case OP_LREFCAR: return jit_lrefcar;
+  case OP_LREFCDR: return jit_lrefcdr;
+  case OP_LREFNILPJMPIF: return jit_lrefnilpjmpif;
+  case OP_LREFADDI: return jit_lrefaddi;
+  case OP_LREFSUBI: return jit_lrefsubi;
+  case OP_RCONS: return jit_rcons;
+  case OP_RCAR: return jit_rcar;
+  case OP_RCDR: return jit_rcdr;
+  case OP_RNILP: return jit_rnilp;
+  case OP_RSYMBOLP: return jit_rsymbolp;
+  case OP_RPAIRP: return jit_rpairp;
+  case OP_RNOT: return jit_rnot;
+  case OP_RADD: return jit_radd;
+  case OP_RSUB: return jit_rsub;
+  case OP_RMUL: return jit_rmul;
+  case OP_RDIV: return jit_rdiv;
+  case OP_REQ: return jit_req;
+  case OP_RLT: return jit_rlt;
+  case OP_RLE: return jit_rle;
+  case OP_RGT: return jit_rgt;
+  case OP_RGE: return jit_rge;
+  default: return NULL;
+  }
+}
+
+#endif
+
+/**
+ * Room for argc arguments on the VM stack just above the slot the
+ * callee will occupy. Both pic_apply and pic_apply_trampoline push the
+ * procedure at pic->sp and copy the arguments right after it, so the
+ * copy degenerates into a no-op and no argument vector has to be
+ * allocated. Nothing may allocate between filling the slots and the
+ * call, as the slots above pic->sp are not traced by the collector,
+ * and pointers into the stack must be taken again afterwards, as the
+ * stack may have been moved to make room.
+ */
+pic_value *
+pic_apply_argv(pic_state *pic, int argc)
+{
+  VM_RESERVE(argc + 1, NULL);
+
+  return pic->sp + 1;
+}
+
+static pic_value *
+vm_spill_list(pic_state *pic, pic_value list, int *argc)
+{
+  pic_value *argv, x, it;
+  int i = 0;
+
+  *argc = pic_length(pic, list);
+
+  argv = pic_apply_argv(pic, *argc);
 
   pic_for_each (x, list, it) {
-    args->data[i++] = x;
+    argv[i++] = x;
   }
+  return argv;
+}
+
+pic_value
+pic_apply_list(pic_state *pic, struct pic_proc *proc, pic_value list)
+{
+  pic_value *argv;
+  int argc;
+
+  argv = vm_spill_list(pic, list, &argc);
 
-  return pic_apply(pic, proc, n, args->data);
+  return pic_apply(pic, proc, argc, argv);
 }
 
 pic_value
@@ -819,6 +1614,9 @@ pic_apply_trampoline(pic_state *pic, struct pic_proc *proc, int argc, pic_value
 
   PIC_INIT_CODE_I(pic->iseq[0], OP_NOP, 0);
   PIC_INIT_CODE_I(pic->iseq[1], OP_TAILCALL, -1);
+  pic->iseq[1].u.call.site = -1;
+
+  VM_RESERVE(argc + 1, &args);
 
   *pic->sp++ = pic_obj_value(proc);
 
@@ -831,6 +1629,9 @@ pic_apply_trampoline(pic_state *pic, struct pic_proc *proc, int argc, pic_value
   ci->ip = pic->iseq;
   ci->fp = pic->sp;
   ci->retc = (int)argc;
+#if VM_PROFILE
+  ci->prof = NULL;
+#endif
 
   if (ci->retc == 0) {
     return pic_undef_value();
@@ -842,34 +1643,60 @@ pic_apply_trampoline(pic_state *pic, struct pic_proc *proc, int argc, pic_value
 pic_value
 pic_apply_trampoline_list(pic_state *pic, struct pic_proc *proc, pic_value args)
 {
-  int i, argc = pic_length(pic, args);
-  pic_value val, it;
-  pic_vec *argv = pic_make_vec(pic, argc);
+  pic_value *argv;
+  int argc;
 
-  i = 0;
-  pic_for_each (val, args, it) {
-    argv->data[i++] = val;
-  }
+  argv = vm_spill_list(pic, args, &argc);
+
+  return pic_apply_trampoline(pic, proc, argc, argv);
+}
+
+/**
+ * apply with the leading arguments in args[0..argc-2] and the list last:
+ * the leading arguments are copied up to where the trampoline will put
+ * them and the list is spilled right after, so nothing is consed.
+ */
+pic_value
+pic_vm_apply_spread(pic_state *pic, struct pic_proc *proc, int argc, pic_value *args)
+{
+  pic_value list, x, it, *argv;
+  int i, n;
+
+  list = args[--argc];
+  n = pic_length(pic, list);
+
+  VM_RESERVE(argc + n + 1, &args);
 
-  return pic_apply_trampoline(pic, proc, argc, argv->data);
+  argv = pic->sp + 1;
+  for (i = 0; i < argc; ++i) {
+    argv[i] = args[i];
+  }
+  pic_for_each (x, list, it) {
+    argv[i++] = x;
+  }
+  return pic_apply_trampoline(pic, proc, i, argv);
 }
 
+/**
+ * pic_apply copies argv onto the VM stack before anything is
+ * allocated, so the arguments can live in a C array.
+ */
 static pic_value
 pic_va_apply(pic_state *pic, struct pic_proc *proc, int n, ...)
 {
-  pic_vec *args = pic_make_vec(pic, n);
+  pic_value args[5];
   va_list ap;
   int i = 0;
 
   va_start(ap, n);
 
   while (i < n) {
-    args->data[i++] = va_arg(ap, pic_value);
+    args[i++] = va_arg(ap, pic_value);
   }
 
   va_end(ap);
 
-  return pic_apply(pic, proc, n, args->data);
+  return pic_apply(pic, proc, n, args);
 }
 
 pic_value
@@ -946,6 +1773,19 @@ pic_defun(pic_state *pic, const char *name, pic_func_t cfunc)
   pic_export(pic, pic_intern(pic, name));
 }
 
+void
+pic_defun_spec_(pic_state *pic, const char *name, pic_func_t cfunc, const char *format)
+{
+  pic_define_(pic, name, pic_obj_value(pic_make_proc_spec(pic, cfunc, format)));
+}
+
+void
+pic_defun_spec(pic_state *pic, const char *name, pic_func_t cfunc, const char *format)
+{
+  pic_defun_spec_(pic, name, cfunc, format);
+  pic_export(pic, pic_intern(pic, name));
+}
+
 void
 pic_defvar_(pic_state *pic, const char *name, pic_value init, struct pic_proc *conv)
 {
@@ -984,7 +1824,7 @@ pic_set(pic_state *pic, struct pic_lib *lib, const char *name, pic_value val)
     pic_errorf(pic, "symbol \"%s\" not defined in library ~s", name, lib->name);
   }
 
-  vm_gset(pic_vm_gref_slot(pic, uid), val);
+  vm_gset(pic, pic_vm_gref_slot(pic, uid), val);
 }
 
 static struct pic_proc *
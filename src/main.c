@@ -40,8 +40,10 @@ main(int argc, char *argv[], char **envp)
   pic_state *pic;
   struct pic_lib *PICRIN_MAIN;
   int status;
+  char t;
 
   pic = pic_open(pic_default_allocf, NULL);
+  pic->native_stack_start = &t; /* the collector scans the stack up to this frame */
   pic_set_argv(pic, argc, argv, envp);
 
   pic_try {